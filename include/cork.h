@@ -0,0 +1,265 @@
+// +-------------------------------------------------------------------------
+// | cork.h
+// | 
+// | Author: Gilbert Bernstein
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    Copyright Gilbert Bernstein 2013
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+#pragma once
+
+#ifndef uint
+typedef unsigned int uint;
+#endif
+
+// if a mesh is taken as input, the client must manage the memory
+// if a mesh is given as output, please use the provided
+// function to free the allocated memory.
+struct CorkTriMesh
+{
+    uint    n_triangles;
+    uint    n_vertices;
+    uint    *triangles;
+    float   *vertices;
+};
+
+void freeCorkTriMesh(CorkTriMesh *mesh);
+
+// the inputs to Boolean operations must be "solid":
+//  -   closed (aka. watertight; see comment at bottom)
+//  -   non-self-intersecting
+// additionally, inputs should use a counter-clockwise convention
+// for triangle facing.  If the triangles are presented in clockwise
+// orientation, the object is interpreted as its unbounded complement
+
+// This function will test whether or not a mesh is solid
+bool isSolid(CorkTriMesh mesh);
+
+// Boolean operations follow
+// result = A U B
+void computeUnion(CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out);
+
+// result = A - B
+void computeDifference(CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out);
+
+// result = A ^ B
+void computeIntersection(CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out);
+
+// result = A XOR B
+void computeSymmetricDifference(
+                        CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out);
+
+// Not a Boolean operation, but related:
+//  No portion of either surface is deleted.  However, the
+//  curve of intersection between the two surfaces is made explicit,
+//  such that the two surfaces are now connected.
+void resolveIntersections(CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out);
+
+// Computes several of the above Boolean results at once, sharing
+// the (expensive) intersection and inside/outside classification work.
+// Pass null for any result that isn't wanted.
+void computeBooleans(CorkTriMesh in0, CorkTriMesh in1,
+                     CorkTriMesh *union_out, CorkTriMesh *diff_out,
+                     CorkTriMesh *isct_out,  CorkTriMesh *xor_out);
+
+// CSG expressions over any number of operands.
+// All of the operands are intersected with each other in one pass,
+// rather than re-intersecting a growing result for every operation.
+enum CorkCSGOp {
+    CORK_CSG_OPERAND,               // one of the input meshes
+    CORK_CSG_UNION,                 // left U right
+    CORK_CSG_DIFFERENCE,            // left - right
+    CORK_CSG_INTERSECTION,          // left ^ right
+    CORK_CSG_SYMMETRIC_DIFFERENCE   // left XOR right
+};
+
+struct CorkCSGNode
+{
+    CorkCSGOp   op;
+    uint        operand;            // index of the mesh, for OPERAND nodes
+    uint        left, right;        // indices of nodes earlier in the list
+};
+
+// The last node is the root of the expression
+void computeCSG(uint n_operands, const CorkTriMesh *operands,
+                uint n_nodes, const CorkCSGNode *nodes, CorkTriMesh *out);
+
+
+
+// A context holds all of the mutable state Cork uses while computing.
+// Operations given different contexts may run concurrently on different
+// threads, but a context must not be used by two operations at once.
+// Entry points below that take a context may be passed a null one,
+// in which case (as with the functions above) a temporary context
+// is used for just that call.
+struct CorkContext;
+
+CorkContext* newCorkContext();
+void freeCorkContext(CorkContext *ctx);
+
+// the context's random source is used to pick ray directions and
+// perturbations.  Each operation draws from it, so the results depend
+// on the seed and on the operations run with the context before; a
+// fresh context, or one seeded again, gives the same results.
+void seedCorkContext(CorkContext *ctx, unsigned long long seed);
+
+// Boolean operations assume that each operand is free of
+// self-intersections, and only look for intersections between them.
+// Turning validation on also resolves self-intersections within each
+// operand (which is slower), as the operations originally did.
+void setCorkOperandValidation(CorkContext *ctx, bool validate);
+
+// the number of threads an operation may use; the default, 0,
+// means one per hardware thread.  Results do not depend on it.
+void setCorkThreadCount(CorkContext *ctx, uint n_threads);
+
+// the number of children per node (2, 4 or 8) in the bounding volume
+// hierarchies that Boolean operations use to find the region where
+// the operands overlap; wider trees are tested with SIMD instructions
+// where the cpu has them.  The default is 4; any other width is
+// ignored, leaving the setting as it was.  (The search for the
+// actual intersections walks two binary hierarchies together, and
+// doesn't depend on this.)
+void setCorkBVHWidth(CorkContext *ctx, uint width);
+
+// statistics accumulated by a context over all of its operations
+struct CorkStats
+{
+    uint    predicate_calls;    // number of exact intersection tests
+    uint    exact_fallbacks;    // of those, number where the floating
+                                // point filter was inconclusive
+    uint    degeneracies;       // and of those, number which were decided
+                                // by the symbolic perturbation
+    uint    bvh_builds;         // number of bounding volume hierarchies built
+    uint    bvh_nodes;          // total number of nodes in them
+    double  bvh_build_time;     // milliseconds spent building them
+    uint    bvh_visits;         // nodes visited while looking for
+                                // (edge, triangle) pairs whose boxes overlap
+    uint    bvh_candidates;     // number of such pairs found
+};
+void getCorkStats(const CorkContext *ctx, CorkStats *stats);
+
+
+// Prepared meshes hold an operand in Cork's internal format, along
+// with data derived from it.  Preparing a mesh once and reusing the
+// handle avoids re-converting it for every operation.  Results may
+// also be returned as prepared meshes, so that chains of operations
+// never round-trip through the (float) CorkTriMesh representation.
+// Prepared meshes are never modified by the operations below.
+struct CorkPreparedMesh;
+
+CorkPreparedMesh* prepareCorkMesh(CorkTriMesh mesh);
+void freeCorkPreparedMesh(CorkPreparedMesh *mesh);
+
+// copy a prepared mesh out; free the result with freeCorkTriMesh()
+void extractCorkTriMesh(const CorkPreparedMesh *mesh, CorkTriMesh *out);
+
+// (the check only runs the first time it's asked of a prepared mesh)
+bool isSolidPrepared(const CorkPreparedMesh *mesh, CorkContext *ctx = 0);
+
+// results are newly allocated prepared meshes;
+// free them with freeCorkPreparedMesh()
+void computeUnionPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx = 0);
+void computeDifferencePrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx = 0);
+void computeIntersectionPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx = 0);
+void computeSymmetricDifferencePrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx = 0);
+void resolveIntersectionsPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx = 0);
+void computeBooleansPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **union_out, CorkPreparedMesh **diff_out,
+    CorkPreparedMesh **isct_out,  CorkPreparedMesh **xor_out,
+    CorkContext *ctx = 0);
+void computeCSGPrepared(
+    uint n_operands, const CorkPreparedMesh * const *operands,
+    uint n_nodes, const CorkCSGNode *nodes,
+    CorkPreparedMesh **out, CorkContext *ctx = 0);
+
+
+
+// Mesh views describe caller-owned buffers, so that meshes can be
+// passed into Cork and results passed back out without intermediate
+// copies.  Strides are given in bytes; a stride of 0 means that the
+// entries are tightly packed.
+enum CorkScalarType { CORK_FLOAT, CORK_DOUBLE };
+
+struct CorkMeshView
+{
+    uint            n_triangles;
+    uint            n_vertices;
+    const uint      *triangles;         // 3 vertex indices per triangle
+    uint            triangle_stride;
+    const void      *vertices;          // 3 coordinates per vertex
+    uint            vertex_stride;
+    CorkScalarType  vertex_type;
+};
+
+struct CorkMutableMeshView
+{
+    uint            *triangles;
+    uint            triangle_stride;
+    void            *vertices;
+    uint            vertex_stride;
+    CorkScalarType  vertex_type;
+};
+
+// Results are written into buffers provided by the client.
+// Once the size of a result is known, allocate() is called; it should
+// fill out the view with buffers large enough to hold the result.
+// If it returns false, the result is discarded.
+struct CorkMeshSink
+{
+    void    *user;
+    bool    (*allocate)(void *user, uint n_vertices, uint n_triangles,
+                        CorkMutableMeshView *out);
+};
+
+bool isSolidView(CorkMeshView mesh, CorkContext *ctx = 0);
+
+void computeUnionView(CorkMeshView in0, CorkMeshView in1,
+                      CorkMeshSink out, CorkContext *ctx = 0);
+void computeDifferenceView(CorkMeshView in0, CorkMeshView in1,
+                           CorkMeshSink out, CorkContext *ctx = 0);
+void computeIntersectionView(CorkMeshView in0, CorkMeshView in1,
+                             CorkMeshSink out, CorkContext *ctx = 0);
+void computeSymmetricDifferenceView(CorkMeshView in0, CorkMeshView in1,
+                                    CorkMeshSink out, CorkContext *ctx = 0);
+void resolveIntersectionsView(CorkMeshView in0, CorkMeshView in1,
+                              CorkMeshSink out, CorkContext *ctx = 0);
+// sinks are passed by pointer here so that unwanted results may be null
+void computeBooleansView(CorkMeshView in0, CorkMeshView in1,
+                         const CorkMeshSink *union_out,
+                         const CorkMeshSink *diff_out,
+                         const CorkMeshSink *isct_out,
+                         const CorkMeshSink *xor_out,
+                         CorkContext *ctx = 0);
+
+CorkPreparedMesh* prepareCorkMeshView(CorkMeshView mesh);
+void extractCorkMeshView(const CorkPreparedMesh *mesh, CorkMeshSink out);
+
@@ -26,11 +26,34 @@
 #pragma once
 
 #include "bbox.h"
+#include "ray.h"
+#include "parallel.h"
+#include "simdBox.h"
 
-#include <stack>
+#include <vector>
+#include <algorithm>
 
 // maximum leaf size
 static const uint LEAF_SIZE = 8;
+// deepest tree we'll build; the traversal stacks are sized by this
+static const uint AABVH_MAX_DEPTH = 64;
+// number of candidate split planes per axis is SAH_BINS-1
+static const uint SAH_BINS = 16;
+// subtrees at least this big get built on their own thread
+// (when the builder was given more than one)
+static const uint PARALLEL_BUILD_SIZE = 4096;
+
+// accumulated over all of the hierarchies built (and queried) with it
+struct AABVHStats
+{
+    uint    builds;
+    uint    nodes;
+    double  build_time;     // milliseconds
+    uint    visits;         // nodes visited by queries
+    uint    candidates;     // hits they reported
+    AABVHStats() : builds(0), nodes(0), build_time(0.0),
+                   visits(0), candidates(0) {}
+};
 
 template<class GeomIdx>
 struct GeomBlob
@@ -40,157 +63,494 @@ struct GeomBlob
     GeomIdx id;
 };
 
-template<class GeomIdx>
+// The nodes are stored in depth first order, so the left child of a
+// node is always the very next node.  Leaves refer to a range of the
+// blob array, which is permuted to keep each leaf's blobs together.
 struct AABVHNode
 {
-    BBox3d                          bbox;
-    AABVHNode                       *left;
-    AABVHNode                       *right;
-    ShortVec<uint, LEAF_SIZE>       blobids;
-    inline bool isLeaf() const { return left == nullptr; }
+    BBox3d  bbox;
+    uint    right;  // index of the right child, or 0 for leaves
+    uint    begin;  // range of blobs in a leaf
+    uint    end;
+    inline bool isLeaf() const { return right == 0; }
+};
+
+// The binary tree can also be collapsed into one with W children
+// per node, whose boxes are laid out so that for_each_in_box can test
+// the query against all of them at once (see simdBox.h).
+// Unused child slots have empty boxes, which never overlap anything.
+template<uint W>
+struct AABVHWideNode
+{
+    double  minp[3][W]; // child boxes, one row per axis
+    double  maxp[3][W];
+    uint    child[W];   // index of an inner child, or a leaf's first blob
+    uint    end[W];     // end of a leaf's blobs, or 0 for inner children
 };
 
 template<class GeomIdx>
 class AABVH
 {
 public:
-    AABVH(const std::vector< GeomBlob<GeomIdx> > &geoms) :
-        root(nullptr), blobs(geoms), tmpids(geoms.size())
+    // n_threads as for parallelFor; stats may be null.
+    // width is the number of children per node to query with: 2, 4 or 8
+    AABVH(const std::vector< GeomBlob<GeomIdx> > &geoms,
+          uint n_threads = 1, AABVHStats *stats = nullptr, uint width = 2) :
+        blobs(geoms)
     {
         ENSURE(blobs.size() > 0);
+        ENSURE(width == 2 || width == 4 || width == 8);
+        Timer timer;
+        
+        // (the build sorts the blobs into leaf order as it goes)
+        if(n_threads == 0)
+            n_threads = defaultThreadCount();
+        constructTree(0, blobs.size(), 0, n_threads, nodes);
         
-        for(uint k=0; k<tmpids.size(); k++)
-            tmpids[k] = k;
+        // a single leaf has nothing to collapse
+        if(!nodes[0].isLeaf()) {
+            if(width == 4)      collapseTree(0, wide4);
+            else if(width == 8) collapseTree(0, wide8);
+        }
         
-        root = constructTree(0, tmpids.size(), 2);
+        if(stats) {
+            stats->builds++;
+            stats->nodes       += nodes.size();
+            stats->build_time  += timer.stop();
+        }
     }
     ~AABVH() {}
     
     // query?
-    inline void for_each_in_box(
-        const BBox3d                        &bbox,
-        std::function<void(GeomIdx idx)>    action
-    ) {
-        // do a recursive search and invoke the action at each
+    // (action is called with the id of each piece of geometry;
+    //  returns the number of nodes visited)
+    template<class Action>
+    inline uint for_each_in_box(const BBox3d &bbox, Action action) const
+    {
+        if(wide4.size() > 0)    return for_each_in_box_wide(wide4, bbox, action);
+        if(wide8.size() > 0)    return for_each_in_box_wide(wide8, bbox, action);
+        
+        // do a depth first search and invoke the action at each
         // piece of geometry
-        std::stack< AABVHNode<GeomIdx>* >  nodes;
-        nodes.push(root);
+        uint stack[AABVH_MAX_DEPTH + 1];
+        uint top = 0;
+        stack[top++] = 0;
+        uint visited = 0;
         
-        while(!nodes.empty()) {
-            AABVHNode<GeomIdx> *node    = nodes.top();
-                                        nodes.pop();
+        while(top > 0) {
+            uint             idx    = stack[--top];
+            const AABVHNode &node   = nodes[idx];
+            visited++;
             
             // check bounding box isct
-            if(!hasIsct(node->bbox, bbox))  continue;
+            if(!hasIsct(node.bbox, bbox))   continue;
             
             // otherwise...
-            if(node->isLeaf()) {
-                for(uint bid : node->blobids) {
-                    if(hasIsct(bbox, blobs[bid].bbox))
-                        action(blobs[bid].id);
+            if(node.isLeaf()) {
+                for(uint k=node.begin; k<node.end; k++) {
+                    if(hasIsct(bbox, blobs[k].bbox))
+                        action(blobs[k].id);
+                }
+            } else {
+                stack[top++] = idx + 1;
+                stack[top++] = node.right;
+            }
+        }
+        return visited;
+    }
+    
+    // Find the pairs (id here, id in other) whose boxes overlap, by
+    // walking both hierarchies at once.  The pairs are handed to the
+    // action in batches of up to batch_size, as a std::vector of
+    // std::pairs; it returns false to stop the search.
+    // (This always walks the binary nodes, whatever the width.)
+    // Returns the number of pairs of nodes visited
+    template<class OtherIdx, class Action>
+    uint for_each_overlap(const AABVH<OtherIdx> &other, uint batch_size,
+                          Action action) const
+    {
+        std::vector< std::pair<GeomIdx, OtherIdx> > batch;
+        batch.reserve(batch_size);
+        
+        // each step opens up one of the two nodes
+        uint stack[2 * (2*AABVH_MAX_DEPTH + 1)];
+        uint top = 0;
+        stack[top++] = 0;
+        stack[top++] = 0;
+        uint visited = 0;
+        
+        while(top > 0) {
+            uint             b      = stack[--top];
+            uint             a      = stack[--top];
+            const AABVHNode &na     = nodes[a];
+            const AABVHNode &nb     = other.nodes[b];
+            visited++;
+            
+            if(!hasIsct(na.bbox, nb.bbox))  continue;
+            
+            if(na.isLeaf() && nb.isLeaf()) {
+                for(uint i=na.begin; i<na.end; i++) {
+                    if(!hasIsct(blobs[i].bbox, nb.bbox))    continue;
+                    for(uint j=nb.begin; j<nb.end; j++) {
+                        if(!hasIsct(blobs[i].bbox, other.blobs[j].bbox))
+                            continue;
+                        batch.push_back(std::make_pair(blobs[i].id,
+                                                       other.blobs[j].id));
+                        if(batch.size() < batch_size)   continue;
+                        if(!action(batch))
+                            return visited;
+                        batch.clear();
+                    }
+                }
+                continue;
+            }
+            
+            // otherwise open up the bigger of the two
+            bool open_a = nb.isLeaf() ||
+                          (!na.isLeaf() &&
+                           surfaceArea(na.bbox) >= surfaceArea(nb.bbox));
+            if(open_a) {
+                stack[top++] = na.right;    stack[top++] = b;
+                stack[top++] = a + 1;       stack[top++] = b;
+            } else {
+                stack[top++] = a;           stack[top++] = nb.right;
+                stack[top++] = a;           stack[top++] = b + 1;
+            }
+        }
+        if(batch.size() > 0)
+            action(batch);
+        return visited;
+    }
+    
+    // invoke the action on every piece of geometry whose box
+    // the ray (t > 0) might pass through
+    template<class Action>
+    inline void for_each_on_ray(const Ray3d &ray, Action action) const
+    {
+        Vec3d inv_dir(1.0 / ray.r.x, 1.0 / ray.r.y, 1.0 / ray.r.z);
+        
+        uint stack[AABVH_MAX_DEPTH + 1];
+        uint top = 0;
+        stack[top++] = 0;
+        
+        while(top > 0) {
+            uint             idx    = stack[--top];
+            const AABVHNode &node   = nodes[idx];
+            
+            if(!hasRayIsct(ray, inv_dir, node.bbox))    continue;
+            
+            if(node.isLeaf()) {
+                for(uint k=node.begin; k<node.end; k++) {
+                    if(hasRayIsct(ray, inv_dir, blobs[k].bbox))
+                        action(blobs[k].id);
                 }
             } else {
-                nodes.push(node->left);
-                nodes.push(node->right);
+                stack[top++] = idx + 1;
+                stack[top++] = node.right;
             }
         }
     }
     
 private:
-    // process range of tmpids including begin, excluding end
-    // last_dim provides a hint by saying which dimension a
-    // split was last made along
-    AABVHNode<GeomIdx>* constructTree(uint begin, uint end, uint last_dim)
+    template<uint W, class Action>
+    inline uint for_each_in_box_wide(
+        const std::vector< AABVHWideNode<W> > &wide,
+        const BBox3d &bbox, Action &action
+    ) const {
+        typedef const AABVHWideNode<W> Node;
+        switch(simdBoxLevel()) {
+#ifdef CORK_AVX2
+        case SIMD_BOX_AVX2:
+            return traverseWide(wide, bbox, action, [](Node &n,
+                                                       const BBox3d &q) {
+                return overlapMaskAVX2<W>(n.minp, n.maxp, q);
+            });
+#endif
+#ifdef CORK_SSE2
+        case SIMD_BOX_SSE2:
+            return traverseWide(wide, bbox, action, [](Node &n,
+                                                       const BBox3d &q) {
+                return overlapMaskSSE2<W>(n.minp, n.maxp, q);
+            });
+#endif
+        default:
+            return traverseWide(wide, bbox, action, [](Node &n,
+                                                       const BBox3d &q) {
+                return overlapMaskScalar<W>(n.minp, n.maxp, q);
+            });
+        }
+    }
+    template<uint W, class Action, class Overlaps>
+    inline uint traverseWide(
+        const std::vector< AABVHWideNode<W> > &wide,
+        const BBox3d &bbox, Action &action, Overlaps overlaps
+    ) const {
+        // each node popped pushes at most W-1 more than it took
+        uint stack[(W-1) * AABVH_MAX_DEPTH + 1];
+        uint top = 0;
+        stack[top++] = 0;
+        uint visited = 0;
+        
+        while(top > 0) {
+            const AABVHWideNode<W> &node = wide[stack[--top]];
+            visited++;
+            
+            uint hits = overlaps(node, bbox);
+            for(uint k=0; hits != 0; k++, hits >>= 1) {
+                if(!(hits & 1))     continue;
+                if(node.end[k] == 0) {
+                    stack[top++] = node.child[k];
+                    continue;
+                }
+                for(uint i=node.child[k]; i<node.end[k]; i++) {
+                    if(hasIsct(bbox, blobs[i].bbox))
+                        action(blobs[i].id);
+                }
+            }
+        }
+        return visited;
+    }
+    
+    // slab test; inv_dir holds the reciprocals of the ray direction
+    static inline bool hasRayIsct(
+        const Ray3d &ray, const Vec3d &inv_dir, const BBox3d &bbox
+    ) {
+        double tmin = 0.0;
+        double tmax = DBL_MAX;
+        for(uint k=0; k<3; k++) {
+            if(ray.r[k] == 0.0) { // parallel to the slab
+                if(ray.p[k] < bbox.minp[k] || ray.p[k] > bbox.maxp[k])
+                    return false;
+                continue;
+            }
+            double t0 = (bbox.minp[k] - ray.p[k]) * inv_dir[k];
+            double t1 = (bbox.maxp[k] - ray.p[k]) * inv_dir[k];
+            if(t0 > t1)     std::swap(t0, t1);
+            tmin = std::max(tmin, t0);
+            tmax = std::min(tmax, t1);
+            if(tmin > tmax) return false;
+        }
+        return true;
+    }
+    
+    // build the tree over blobs[begin, end) onto the end of out,
+    // and return the index of its root in out
+    uint constructTree(uint begin, uint end, uint depth, uint n_threads,
+                       std::vector<AABVHNode> &out)
     {
         ENSURE(end - begin > 0); // don't tell me to build a tree from nothing
-        // base case
-        if(end-begin <= LEAF_SIZE) {
-            AABVHNode<GeomIdx> *node = node_pool.alloc();
-            node->left = nullptr;
-            node->blobids.resize(end-begin);
-            for(uint k=0; k<end-begin; k++) {
-                uint blobid = node->blobids[k] = tmpids[begin + k];
-                node->bbox = convex(node->bbox, blobs[blobid].bbox);
-            }
-            return node;
+        ENSURE(depth < AABVH_MAX_DEPTH);
+        uint idx = out.size();
+        out.push_back(AABVHNode());
+        
+        // we split on the representative points
+        BBox3d bbox;
+        BBox3d centers;
+        for(uint k=begin; k<end; k++) {
+            const GeomBlob<GeomIdx> &blob = blobs[k];
+            bbox    = convex(bbox, blob.bbox);
+            centers = convex(centers, BBox3d(blob.point, blob.point));
         }
-        // otherwise, let's try to split this geometry up
+        out[idx].bbox   = bbox;
+        out[idx].right  = 0;
+        out[idx].begin  = begin;
+        out[idx].end    = end;
+        // base case
+        if(end-begin <= LEAF_SIZE)
+            return idx;
         
-        uint dim = (last_dim+1)%3;
-        uint mid = (begin + end) / 2;
-        quickSelect(mid, begin, end, dim);
+        // otherwise, let's try to split this geometry up.
+        // Past half of the depth budget, median splits make sure
+        // that we run out of geometry before we run out of depth
+        uint mid = begin;
+        if(depth < AABVH_MAX_DEPTH/2)
+            mid = splitSAH(begin, end, centers);
+        if(mid == begin || mid == end)
+            mid = splitMedian(begin, end, centers);
         
         // now recurse
-        AABVHNode<GeomIdx> *node = node_pool.alloc();
-        node->left = constructTree(begin, mid, dim);
-        node->right = constructTree(mid, end, dim);
-        node->bbox = convex(node->left->bbox, node->right->bbox);
-        return node;
+        uint right;
+        if(n_threads > 1 && end - begin >= PARALLEL_BUILD_SIZE) {
+            // build the halves side by side, then splice them in
+            std::vector<AABVHNode> halves[2];
+            uint ranges[3]  = { begin, mid, end };
+            uint threads[2] = { n_threads / 2, n_threads - n_threads / 2 };
+            parallelFor(2, 2, [&](uint i, uint) {
+                constructTree(ranges[i], ranges[i+1], depth+1, threads[i],
+                              halves[i]);
+            });
+                    splice(out, halves[0]);
+            right = splice(out, halves[1]);
+        } else {
+            // (the left child lands right after this node)
+                    constructTree(begin, mid, depth+1, 1, out);
+            right = constructTree(mid, end, depth+1, 1, out);
+        }
+        out[idx].right = right;
+        return idx;
+    }
+    
+    // append the nodes of a subtree, returning where its root went
+    static uint splice(std::vector<AABVHNode> &out,
+                       const std::vector<AABVHNode> &subtree)
+    {
+        uint base = out.size();
+        for(AABVHNode node : subtree) {
+            if(!node.isLeaf())
+                node.right += base;
+            out.push_back(node);
+        }
+        return base;
     }
     
-    // precondition: begin <= select < end
-    void quickSelect(uint select, uint begin, uint end, uint dim)
+    // Partition blobs[begin, end) at the cheapest of the planes
+    // between SAH_BINS equal bins of the representative points,
+    // along each axis.  The cost of a split is the surface area
+    // of each side times the amount of geometry on it.
+    // Returns the start of the second half (begin if nothing splits)
+    uint splitSAH(uint begin, uint end, const BBox3d &centers)
     {
-        // NOTE: values equal to the pivot
-        //       may appear on either side of the split
-        if(end-1 == select)     return;
-        
-        // p(ivot)i(ndex) and p(ivot)v(alue)
-        uint pi = randMod(end-begin) + begin;
-        double pv = blobs[tmpids[pi]].point[dim];
-        
-        int front = begin;
-        int back  = end-1;
-        while(front < back) {
-            if(blobs[tmpids[front]].point[dim] < pv) {
-                front++;
+        Vec3d   lo      = centers.minp;
+        Vec3d   extent  = centers.maxp - centers.minp;
+        Vec3d   scale;  // (flat axes put everything in bin 0)
+        for(uint dim=0; dim<3; dim++)
+            scale[dim] = (extent[dim] > 0.0)? SAH_BINS / extent[dim] : 0.0;
+        
+        // bin everything along all three axes in one pass
+        BBox3d  bin_bbox[3][SAH_BINS];
+        uint    bin_count[3][SAH_BINS] = {};
+        for(uint k=begin; k<end; k++) {
+            const GeomBlob<GeomIdx> &blob = blobs[k];
+            for(uint dim=0; dim<3; dim++) {
+                uint b = binOf(blob.point[dim], lo[dim], scale[dim]);
+                bin_bbox[dim][b] = convex(bin_bbox[dim][b], blob.bbox);
+                bin_count[dim][b]++;
             }
-            else if(blobs[tmpids[back]].point[dim] > pv) {
-                back--;
+        }
+        
+        double  best_cost   = DBL_MAX;
+        uint    best_dim    = 0;
+        uint    best_plane  = 0;
+        for(uint dim=0; dim<3; dim++) {
+            if(!(extent[dim] > 0.0))    continue;
+            // sweep in from the right, then from the left
+            double  right_cost[SAH_BINS];
+            BBox3d  acc;
+            uint    count = 0;
+            for(uint b=SAH_BINS-1; b>0; b--) {
+                acc     = convex(acc, bin_bbox[dim][b]);
+                count  += bin_count[dim][b];
+                right_cost[b] = (count > 0)? surfaceArea(acc) * count : 0.0;
             }
-            else {
-                std::swap(tmpids[front], tmpids[back]);
-                front++;
-                back--;
+            acc     = BBox3d();
+            count   = 0;
+            for(uint b=0; b+1<SAH_BINS; b++) {
+                acc     = convex(acc, bin_bbox[dim][b]);
+                count  += bin_count[dim][b];
+                if(count == 0 || count == end - begin)  continue;
+                double cost = surfaceArea(acc) * count + right_cost[b+1];
+                if(cost < best_cost) {
+                    best_cost   = cost;
+                    best_dim    = dim;
+                    best_plane  = b+1;
+                }
             }
         }
-        if(front == back && blobs[tmpids[front]].point[dim] <= pv) {
-            front++;
+        if(best_cost == DBL_MAX)
+            return begin;
+        
+        auto split = std::partition(
+            blobs.begin() + begin, blobs.begin() + end,
+            [&](const GeomBlob<GeomIdx> &blob) {
+                return binOf(blob.point[best_dim],
+                             lo[best_dim], scale[best_dim]) < best_plane;
+            });
+        return split - blobs.begin();
+    }
+    static inline uint binOf(double x, double lo, double scale)
+    {
+        uint b = uint((x - lo) * scale);
+        return std::min(b, SAH_BINS-1);
+    }
+    
+    // Collapse the binary subtree under inner node idx into a wide node
+    // appended to out (its children after it), returning its index.
+    // The children are found by repeatedly opening up the inner child
+    // with the largest surface area, until there are W of them.
+    template<uint W>
+    uint collapseTree(uint idx, std::vector< AABVHWideNode<W> > &out)
+    {
+        uint kids[W];
+        uint n = 0;
+        kids[n++] = idx + 1;
+        kids[n++] = nodes[idx].right;
+        while(n < W) {
+            uint    best        = W;
+            double  best_area   = -1.0;
+            for(uint k=0; k<n; k++) {
+                const AABVHNode &kid = nodes[kids[k]];
+                if(kid.isLeaf())    continue;
+                double area = surfaceArea(kid.bbox);
+                if(area > best_area) {
+                    best        = k;
+                    best_area   = area;
+                }
+            }
+            if(best == W)   break; // all leaves
+            uint opened = kids[best];
+            kids[best]  = opened + 1;
+            kids[n++]   = nodes[opened].right;
         }
         
-        if(select < uint(front)) {
-            quickSelect(select, begin, front, dim);
-        } else {
-            quickSelect(select, front, end, dim);
+        uint wi = out.size();
+        out.push_back(AABVHWideNode<W>());
+        for(uint k=0; k<W; k++) {
+            uint child  = 0;
+            uint end    = 0;
+            BBox3d bbox; // (empty)
+            if(k < n) {
+                const AABVHNode &kid = nodes[kids[k]];
+                bbox = kid.bbox;
+                if(kid.isLeaf()) {
+                    child   = kid.begin;
+                    end     = kid.end;
+                } else {
+                    child   = collapseTree(kids[k], out);
+                }
+            }
+            // (out may have moved while collapsing the child)
+            AABVHWideNode<W> &node = out[wi];
+            for(uint a=0; a<3; a++) {
+                node.minp[a][k] = bbox.minp[a];
+                node.maxp[a][k] = bbox.maxp[a];
+            }
+            node.child[k]   = child;
+            node.end[k]     = end;
         }
+        return wi;
+    }
+    
+    // fallback: split in half along the longest axis
+    uint splitMedian(uint begin, uint end, const BBox3d &centers)
+    {
+        uint dim = maxDim(centers.maxp - centers.minp);
+        uint mid = (begin + end) / 2;
+        std::nth_element(
+            blobs.begin() + begin, blobs.begin() + mid, blobs.begin() + end,
+            [&](const GeomBlob<GeomIdx> &a, const GeomBlob<GeomIdx> &b) {
+                return a.point[dim] < b.point[dim];
+            });
+        return mid;
     }
 private:
-    AABVHNode<GeomIdx>                  *root;
+    template<class> friend class AABVH; // (for for_each_overlap)
     
-    IterPool< AABVHNode<GeomIdx> >      node_pool;
+    std::vector<AABVHNode>              nodes;
+    std::vector< AABVHWideNode<4> >     wide4; // (when collapsed)
+    std::vector< AABVHWideNode<8> >     wide8;
     std::vector< GeomBlob<GeomIdx> >    blobs;
-    std::vector<uint>                   tmpids; // used during construction
 };
 
 
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
 
@@ -0,0 +1,261 @@
+// +-------------------------------------------------------------------------
+// | fastWinding.h
+// | 
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+#pragma once
+
+#include "bbox.h"
+#include "parallel.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Generalized winding numbers of query points with respect to a
+// triangle soup, after Barill et al. "Fast Winding Numbers for Soups
+// and Clouds".  For a closed, outward oriented surface this is 1 inside
+// and 0 outside; near the surface the answer degrades gracefully.
+//
+// Triangles are kept in a hierarchy.  Far away clusters of triangles
+// are approximated by the first two terms of the Taylor series of the
+// kernel  G(x) = (x-q)/|x-q|^3  about the area weighted centroid c:
+// a dipole (the area weighted normal at c) and a correction for how
+// the triangles are spread around c.  Near ones are summed exactly.
+//
+// The approximation comes with a bound on its error.  The second
+// derivative of G has norm at most 6/|x-q|^4 (G is the gradient of
+// 1/|x-q|).  So if the cluster is within r of c, and c is dist from q,
+// the Taylor remainder is at most  3 r^2/(dist-r)^4  at any point of
+// the cluster, and its term is off by at most  area * 3 r^2/(dist-r)^4
+// (over 4 pi).  The bound is the sum of these; rounding is far below
+// it for any point not right on the surface.
+//  A cluster is only approximated if its bound is at most its share
+// (by area) of FAST_WINDING_TOLERANCE, so the total bound never exceeds
+// that.  Since the winding number of a closed surface is a whole
+// number, the approximation then always tells inside from outside,
+// except within the tolerance of 0.5 (i.e. right on the surface).
+
+// how far the approximate winding number may be from the exact one
+static const double FAST_WINDING_TOLERANCE = 0.25;
+static const uint   FAST_WINDING_LEAF_SIZE = 8;
+
+struct WindingTri
+{
+    Vec3d   v[3];
+};
+
+// solid angle of triangle (a,b,c) as seen from the origin,
+// (Van Oosterom and Strackee)
+inline double solidAngle(const Vec3d &a, const Vec3d &b, const Vec3d &c)
+{
+    double la = len(a);
+    double lb = len(b);
+    double lc = len(c);
+    double numer = det(a, b, c);
+    double denom = la*lb*lc + dot(a,b)*lc + dot(b,c)*la + dot(c,a)*lb;
+    return 2.0 * atan2(numer, denom);
+}
+
+class FastWinding
+{
+public:
+    FastWinding(const std::vector<WindingTri> &input) :
+        tris(input)
+    {
+        ENSURE(tris.size() > 0);
+        
+        centroids.resize(tris.size());
+        for(uint i=0; i<tris.size(); i++)
+            centroids[i] = (tris[i].v[0] + tris[i].v[1] + tris[i].v[2]) / 3.0;
+        
+        std::vector<uint> order(tris.size());
+        for(uint i=0; i<order.size(); i++)
+            order[i] = i;
+        constructTree(order, 0, order.size());
+        
+        // a node may be approximated when its distance d from the query,
+        // less its radius r, has  (d-r)^4 >= far_factor * r^2
+        far_factor = 3.0 * nodes[0].area /
+                     (4.0 * M_PI * FAST_WINDING_TOLERANCE);
+        
+        // store the triangles in leaf order, so that
+        // each node covers a contiguous run of them
+        std::vector<WindingTri> sorted(tris.size());
+        for(uint i=0; i<order.size(); i++)
+            sorted[i] = tris[order[i]];
+        tris.swap(sorted);
+        centroids.clear();
+    }
+    
+    // winding number of q, using the far field approximation;
+    // it's within *error (at most FAST_WINDING_TOLERANCE) of the exact one
+    double winding(const Vec3d &q, double *error) const
+    {
+        double sum = 0.0;
+        double err = 0.0;
+        std::vector<uint> stack;
+        stack.push_back(0);
+        while(!stack.empty()) {
+            const Node &node = nodes[stack.back()];
+                               stack.pop_back();
+            
+            Vec3d  d    = node.center - q;
+            double dist = len(d);
+            double gap  = dist - node.radius;
+            if(gap > 0.0 &&
+               gap*gap*gap*gap >= far_factor * node.radius * node.radius) {
+                double dist3 = dist*dist*dist;
+                Vec3d  u     = d / dist;
+                double trace = node.spread[0].x + node.spread[1].y +
+                                                  node.spread[2].z;
+                double uMu   = u.x * dot(node.spread[0], u) +
+                               u.y * dot(node.spread[1], u) +
+                               u.z * dot(node.spread[2], u);
+                sum += dot(d, node.normal) / dist3;
+                sum += (trace - 3.0 * uMu) / dist3;
+                err += node.area * 3.0 * node.radius * node.radius /
+                       (gap*gap*gap*gap);
+            } else if(node.left == 0) {
+                sum += exactRange(q, node.begin, node.end);
+            } else {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+        *error = err / (4.0 * M_PI);
+        return sum / (4.0 * M_PI);
+    }
+    
+    // winding number of q, summing every triangle exactly
+    double exactWinding(const Vec3d &q) const
+    {
+        return exactRange(q, 0, tris.size()) / (4.0 * M_PI);
+    }
+    
+    // evaluate a whole batch of query points at once,
+    // spread over n_threads (see parallelFor)
+    void windings(const std::vector<Vec3d> &qs,
+                  std::vector<double> &out, std::vector<double> &errors,
+                  uint n_threads = 1) const
+    {
+        out.resize(qs.size());
+        errors.resize(qs.size());
+        parallelFor(qs.size(), n_threads, [&](uint i, uint) {
+            out[i] = winding(qs[i], &errors[i]);
+        }, 64);
+    }
+    
+private:
+    struct Node {
+        Vec3d   center; // area weighted centroid
+        Vec3d   normal; // area weighted normal (sum of half cross products)
+        Vec3d   spread[3]; // spread[i] = sum of normal[i] * (centroid - center)
+                           // over the triangles
+        double  area;   // total (unsigned) area of the triangles
+        double  radius; // bounds the distance from center to the triangles
+        uint    begin;  // range of triangles covered
+        uint    end;
+        uint    left;   // children (0 for a leaf; the root is never a child)
+        uint    right;
+    };
+    
+    double exactRange(const Vec3d &q, uint begin, uint end) const
+    {
+        double sum = 0.0;
+        for(uint i=begin; i<end; i++) {
+            const WindingTri &tri = tris[i];
+            sum += solidAngle(tri.v[0] - q, tri.v[1] - q, tri.v[2] - q);
+        }
+        return sum;
+    }
+    
+    // build the node covering order[begin, end) and return its index
+    uint constructTree(std::vector<uint> &order, uint begin, uint end)
+    {
+        uint idx = nodes.size();
+        nodes.push_back(Node());
+        
+        BBox3d box;
+        Vec3d  weighted(0,0,0);
+        Vec3d  normal(0,0,0);
+        double area = 0.0;
+        for(uint k=begin; k<end; k++) {
+            const WindingTri &tri = tris[order[k]];
+            Vec3d  n = 0.5 * cross(tri.v[1] - tri.v[0], tri.v[2] - tri.v[0]);
+            double a = len(n);
+            weighted += a * centroids[order[k]];
+            normal   += n;
+            area     += a;
+            for(uint j=0; j<3; j++)
+                box = convex(box, BBox3d(tri.v[j], tri.v[j]));
+        }
+        Vec3d center = (area > 0.0)? weighted / area
+                                   : (box.minp + box.maxp) / 2.0;
+        // the farthest box corner bounds every triangle
+        Vec3d far_corner = max(abs(box.minp - center), abs(box.maxp - center));
+        
+        Vec3d spread[3] = { Vec3d(0,0,0), Vec3d(0,0,0), Vec3d(0,0,0) };
+        for(uint k=begin; k<end; k++) {
+            const WindingTri &tri = tris[order[k]];
+            Vec3d n = 0.5 * cross(tri.v[1] - tri.v[0], tri.v[2] - tri.v[0]);
+            Vec3d offset = centroids[order[k]] - center;
+            for(uint i=0; i<3; i++)
+                spread[i] += n[i] * offset;
+        }
+        
+        Node &node  = nodes[idx];
+        node.center = center;
+        node.normal = normal;
+        for(uint i=0; i<3; i++)
+            node.spread[i] = spread[i];
+        node.area   = area;
+        node.radius = len(far_corner);
+        node.begin  = begin;
+        node.end    = end;
+        node.left   = 0;
+        node.right  = 0;
+        
+        if(end - begin > FAST_WINDING_LEAF_SIZE) {
+            // split at the median centroid along the longest box side
+            uint dim = maxDim(box.maxp - box.minp);
+            uint mid = (begin + end) / 2;
+            std::nth_element(order.begin() + begin,
+                             order.begin() + mid,
+                             order.begin() + end,
+                             [&](uint a, uint b) {
+                return centroids[a][dim] < centroids[b][dim];
+            });
+            uint left   = constructTree(order, begin, mid);
+            uint right  = constructTree(order, mid, end);
+            nodes[idx].left  = left; // (nodes may have been reallocated)
+            nodes[idx].right = right;
+        }
+        return idx;
+    }
+    
+private:
+    std::vector<WindingTri>     tris;
+    std::vector<Vec3d>          centroids; // used during construction
+    std::vector<Node>           nodes;
+    double                      far_factor;
+};
+
@@ -0,0 +1,130 @@
+// +-------------------------------------------------------------------------
+// | simdBox.h
+// | 
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+#pragma once
+
+#include "bbox.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CORK_SSE2
+#include <emmintrin.h>
+#endif
+// AVX2 code is compiled for its own functions only, and picked at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CORK_AVX2
+#include <immintrin.h>
+#endif
+
+// Overlap tests of one query box against W boxes at once.
+// The boxes are stored one row per axis, minp[axis][k] and maxp[axis][k],
+// and bit k of the returned mask is set when box k overlaps the query,
+// with the same (closed) test as hasIsct().  W must be a multiple of 4.
+
+enum SimdBoxLevel {
+    SIMD_BOX_SCALAR,
+    SIMD_BOX_SSE2,
+    SIMD_BOX_AVX2,
+};
+
+// best level the running cpu supports (decided once)
+inline SimdBoxLevel simdBoxLevel()
+{
+#ifdef CORK_AVX2
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if(has_avx2)    return SIMD_BOX_AVX2;
+#endif
+#ifdef CORK_SSE2
+    return SIMD_BOX_SSE2;
+#else
+    return SIMD_BOX_SCALAR;
+#endif
+}
+
+template<uint W>
+inline uint overlapMaskScalar(
+    const double (&minp)[3][W], const double (&maxp)[3][W], const BBox3d &q
+) {
+    uint mask = 0;
+    for(uint k=0; k<W; k++) {
+        bool hit = minp[0][k] <= q.maxp.x && maxp[0][k] >= q.minp.x &&
+                   minp[1][k] <= q.maxp.y && maxp[1][k] >= q.minp.y &&
+                   minp[2][k] <= q.maxp.z && maxp[2][k] >= q.minp.z;
+        mask |= uint(hit) << k;
+    }
+    return mask;
+}
+
+#ifdef CORK_SSE2
+template<uint W>
+inline uint overlapMaskSSE2(
+    const double (&minp)[3][W], const double (&maxp)[3][W], const BBox3d &q
+) {
+    __m128d qlo[3], qhi[3];
+    for(uint a=0; a<3; a++) {
+        qlo[a] = _mm_set1_pd(q.minp[a]);
+        qhi[a] = _mm_set1_pd(q.maxp[a]);
+    }
+    uint mask = 0;
+    for(uint k=0; k<W; k+=2) {
+        __m128d hit = _mm_and_pd(
+            _mm_cmple_pd(_mm_loadu_pd(&minp[0][k]), qhi[0]),
+            _mm_cmpge_pd(_mm_loadu_pd(&maxp[0][k]), qlo[0]));
+        for(uint a=1; a<3; a++) {
+            hit = _mm_and_pd(hit, _mm_cmple_pd(_mm_loadu_pd(&minp[a][k]),
+                                               qhi[a]));
+            hit = _mm_and_pd(hit, _mm_cmpge_pd(_mm_loadu_pd(&maxp[a][k]),
+                                               qlo[a]));
+        }
+        mask |= uint(_mm_movemask_pd(hit)) << k;
+    }
+    return mask;
+}
+#endif
+
+#ifdef CORK_AVX2
+template<uint W>
+__attribute__((target("avx2"))) uint overlapMaskAVX2(
+    const double (&minp)[3][W], const double (&maxp)[3][W], const BBox3d &q
+) {
+    __m256d qlo[3], qhi[3];
+    for(uint a=0; a<3; a++) {
+        qlo[a] = _mm256_set1_pd(q.minp[a]);
+        qhi[a] = _mm256_set1_pd(q.maxp[a]);
+    }
+    uint mask = 0;
+    for(uint k=0; k<W; k+=4) {
+        __m256d hit = _mm256_and_pd(
+            _mm256_cmp_pd(_mm256_loadu_pd(&minp[0][k]), qhi[0], _CMP_LE_OQ),
+            _mm256_cmp_pd(_mm256_loadu_pd(&maxp[0][k]), qlo[0], _CMP_GE_OQ));
+        for(uint a=1; a<3; a++) {
+            hit = _mm256_and_pd(hit, _mm256_cmp_pd(
+                _mm256_loadu_pd(&minp[a][k]), qhi[a], _CMP_LE_OQ));
+            hit = _mm256_and_pd(hit, _mm256_cmp_pd(
+                _mm256_loadu_pd(&maxp[a][k]), qlo[a], _CMP_GE_OQ));
+        }
+        mask |= uint(_mm256_movemask_pd(hit)) << k;
+    }
+    return mask;
+}
+#endif
@@ -26,6 +26,9 @@
 #include "cork.h"
 
 #include "mesh.h"
+#include "bbox.h"
+
+#include <mutex>
 
 
 void freeCorkTriMesh(CorkTriMesh *mesh)
@@ -111,82 +114,164 @@ struct CorkTriangle :
 typedef RawMesh<CorkVertex, CorkTriangle>   RawCorkMesh;
 typedef Mesh<CorkVertex, CorkTriangle>      CorkMesh;
 
-void corkTriMesh2CorkMesh(
-    CorkTriMesh in,
+// read straight out of the client's buffers into the mesh
+void corkView2CorkMesh(
+    CorkMeshView in,
     CorkMesh *mesh_out
 ) {
-    RawCorkMesh raw;
-    raw.vertices.resize(in.n_vertices);
-    raw.triangles.resize(in.n_triangles);
     if(in.n_vertices == 0 || in.n_triangles == 0) {
         CORK_ERROR("empty mesh input to Cork routine.");
-        *mesh_out = CorkMesh(raw);
+        *mesh_out = CorkMesh();
         return;
     }
     
+    uint tstride = (in.triangle_stride)? in.triangle_stride : 3*sizeof(uint);
+    const byte *tbytes = reinterpret_cast<const byte*>(in.triangles);
     uint max_ref_idx = 0;
     for(uint i=0; i<in.n_triangles; i++) {
-        raw.triangles[i].a = in.triangles[3*i+0];
-        raw.triangles[i].b = in.triangles[3*i+1];
-        raw.triangles[i].c = in.triangles[3*i+2];
+        const uint *tri = reinterpret_cast<const uint*>(tbytes + i*tstride);
         max_ref_idx = std::max(
-                        std::max(max_ref_idx,
-                                 in.triangles[3*i+0]),
-                        std::max(in.triangles[3*i+1],
-                                 in.triangles[3*i+2])
+                        std::max(max_ref_idx, tri[0]),
+                        std::max(tri[1], tri[2])
                       );
     }
-    if(max_ref_idx > in.n_vertices) {
+    if(max_ref_idx >= in.n_vertices) {
         CORK_ERROR("mesh input to Cork routine has an out of range reference "
               "to a vertex.");
-        raw.vertices.clear();
-        raw.triangles.clear();
-        *mesh_out = CorkMesh(raw);
+        *mesh_out = CorkMesh();
         return;
     }
     
-    for(uint i=0; i<in.n_vertices; i++) {
-        raw.vertices[i].pos.x = in.vertices[3*i+0];
-        raw.vertices[i].pos.y = in.vertices[3*i+1];
-        raw.vertices[i].pos.z = in.vertices[3*i+2];
+    mesh_out->resize(in.n_vertices, in.n_triangles);
+    
+    for(uint i=0; i<in.n_triangles; i++) {
+        const uint *tri = reinterpret_cast<const uint*>(tbytes + i*tstride);
+        uint *tv = mesh_out->triVerts(i);
+        tv[0] = tri[0];
+        tv[1] = tri[1];
+        tv[2] = tri[2];
     }
     
-    *mesh_out = CorkMesh(raw);
+    const byte *vbytes = reinterpret_cast<const byte*>(in.vertices);
+    if(in.vertex_type == CORK_DOUBLE) {
+        uint vstride = (in.vertex_stride)? in.vertex_stride : 3*sizeof(double);
+        for(uint i=0; i<in.n_vertices; i++) {
+            const double *p =
+                reinterpret_cast<const double*>(vbytes + i*vstride);
+            mesh_out->vertex(i).pos = Vec3d(p[0], p[1], p[2]);
+        }
+    } else {
+        uint vstride = (in.vertex_stride)? in.vertex_stride : 3*sizeof(float);
+        for(uint i=0; i<in.n_vertices; i++) {
+            const float *p =
+                reinterpret_cast<const float*>(vbytes + i*vstride);
+            mesh_out->vertex(i).pos = Vec3d(p[0], p[1], p[2]);
+        }
+    }
 }
-void corkMesh2CorkTriMesh(
-    CorkMesh *mesh_in,
-    CorkTriMesh *out
+// and write straight into the client's buffers
+void corkMesh2CorkSink(
+    const CorkMesh *mesh_in,
+    CorkMeshSink out
 ) {
-    RawCorkMesh raw = mesh_in->raw();
+    uint n_vertices  = mesh_in->numVerts();
+    uint n_triangles = mesh_in->numTris();
     
-    out->n_triangles = raw.triangles.size();
-    out->n_vertices  = raw.vertices.size();
-    
-    out->triangles = new uint[(out->n_triangles) * 3];
-    out->vertices  = new float[(out->n_vertices) * 3];
+    CorkMutableMeshView view;
+    if(!out.allocate(out.user, n_vertices, n_triangles, &view))
+        return;
     
-    for(uint i=0; i<out->n_triangles; i++) {
-        (out->triangles)[3*i+0] = raw.triangles[i].a;
-        (out->triangles)[3*i+1] = raw.triangles[i].b;
-        (out->triangles)[3*i+2] = raw.triangles[i].c;
+    uint tstride = (view.triangle_stride)? view.triangle_stride
+                                         : 3*sizeof(uint);
+    byte *tbytes = reinterpret_cast<byte*>(view.triangles);
+    for(uint i=0; i<n_triangles; i++) {
+        uint *tri = reinterpret_cast<uint*>(tbytes + i*tstride);
+        const uint *tv = mesh_in->triVerts(i);
+        tri[0] = tv[0];
+        tri[1] = tv[1];
+        tri[2] = tv[2];
     }
     
-    for(uint i=0; i<out->n_vertices; i++) {
-        (out->vertices)[3*i+0] = raw.vertices[i].pos.x;
-        (out->vertices)[3*i+1] = raw.vertices[i].pos.y;
-        (out->vertices)[3*i+2] = raw.vertices[i].pos.z;
+    byte *vbytes = reinterpret_cast<byte*>(view.vertices);
+    if(view.vertex_type == CORK_DOUBLE) {
+        uint vstride = (view.vertex_stride)? view.vertex_stride
+                                           : 3*sizeof(double);
+        for(uint i=0; i<n_vertices; i++) {
+            double *p = reinterpret_cast<double*>(vbytes + i*vstride);
+            const Vec3d &pos = mesh_in->vertex(i).pos;
+            p[0] = pos.x;
+            p[1] = pos.y;
+            p[2] = pos.z;
+        }
+    } else {
+        uint vstride = (view.vertex_stride)? view.vertex_stride
+                                           : 3*sizeof(float);
+        for(uint i=0; i<n_vertices; i++) {
+            float *p = reinterpret_cast<float*>(vbytes + i*vstride);
+            const Vec3d &pos = mesh_in->vertex(i).pos;
+            p[0] = pos.x;
+            p[1] = pos.y;
+            p[2] = pos.z;
+        }
     }
 }
 
+static CorkMeshView corkTriMeshView(CorkTriMesh in)
+{
+    CorkMeshView view;
+    view.n_triangles        = in.n_triangles;
+    view.n_vertices         = in.n_vertices;
+    view.triangles          = in.triangles;
+    view.triangle_stride    = 0;
+    view.vertices           = in.vertices;
+    view.vertex_stride      = 0;
+    view.vertex_type        = CORK_FLOAT;
+    return view;
+}
+
+static bool allocCorkTriMesh(
+    void *user, uint n_vertices, uint n_triangles, CorkMutableMeshView *view
+) {
+    CorkTriMesh *out = reinterpret_cast<CorkTriMesh*>(user);
+    out->n_triangles = n_triangles;
+    out->n_vertices  = n_vertices;
+    out->triangles   = new uint[n_triangles * 3];
+    out->vertices    = new float[n_vertices * 3];
+    
+    view->triangles         = out->triangles;
+    view->triangle_stride   = 0;
+    view->vertices          = out->vertices;
+    view->vertex_stride     = 0;
+    view->vertex_type       = CORK_FLOAT;
+    return true;
+}
+
+void corkTriMesh2CorkMesh(
+    CorkTriMesh in,
+    CorkMesh *mesh_out
+) {
+    corkView2CorkMesh(corkTriMeshView(in), mesh_out);
+}
+void corkMesh2CorkTriMesh(
+    const CorkMesh *mesh_in,
+    CorkTriMesh *out
+) {
+    CorkMeshSink sink;
+    sink.user       = out;
+    sink.allocate   = allocCorkTriMesh;
+    corkMesh2CorkSink(mesh_in, sink);
+}
+
 
 bool isSolid(CorkTriMesh cmesh)
 {
+    CorkContext ctx;
     CorkMesh mesh;
     corkTriMesh2CorkMesh(cmesh, &mesh);
     
     bool solid = true;
     
-    if(mesh.isSelfIntersecting()) {
+    if(mesh.isSelfIntersecting(&ctx)) {
         CORK_ERROR("isSolid() was given a self-intersecting mesh");
         solid = false;
     }
@@ -202,11 +287,12 @@ bool isSolid(CorkTriMesh cmesh)
 void computeUnion(
     CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out
 ) {
+    CorkContext ctx;
     CorkMesh cmIn0, cmIn1;
     corkTriMesh2CorkMesh(in0, &cmIn0);
     corkTriMesh2CorkMesh(in1, &cmIn1);
     
-    cmIn0.boolUnion(cmIn1);
+    cmIn0.boolUnion(cmIn1, &ctx);
     
     corkMesh2CorkTriMesh(&cmIn0, out);
 }
@@ -214,11 +300,12 @@ void computeUnion(
 void computeDifference(
     CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out
 ) {
+    CorkContext ctx;
     CorkMesh cmIn0, cmIn1;
     corkTriMesh2CorkMesh(in0, &cmIn0);
     corkTriMesh2CorkMesh(in1, &cmIn1);
     
-    cmIn0.boolDiff(cmIn1);
+    cmIn0.boolDiff(cmIn1, &ctx);
     
     corkMesh2CorkTriMesh(&cmIn0, out);
 }
@@ -226,11 +313,12 @@ void computeDifference(
 void computeIntersection(
     CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out
 ) {
+    CorkContext ctx;
     CorkMesh cmIn0, cmIn1;
     corkTriMesh2CorkMesh(in0, &cmIn0);
     corkTriMesh2CorkMesh(in1, &cmIn1);
     
-    cmIn0.boolIsct(cmIn1);
+    cmIn0.boolIsct(cmIn1, &ctx);
     
     corkMesh2CorkTriMesh(&cmIn0, out);
 }
@@ -238,11 +326,12 @@ void computeIntersection(
 void computeSymmetricDifference(
     CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out
 ) {
+    CorkContext ctx;
     CorkMesh cmIn0, cmIn1;
     corkTriMesh2CorkMesh(in0, &cmIn0);
     corkTriMesh2CorkMesh(in1, &cmIn1);
     
-    cmIn0.boolXor(cmIn1);
+    cmIn0.boolXor(cmIn1, &ctx);
     
     corkMesh2CorkTriMesh(&cmIn0, out);
 }
@@ -250,13 +339,483 @@ void computeSymmetricDifference(
 void resolveIntersections(
     CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out
 ) {
+    CorkContext ctx;
     CorkMesh cmIn0, cmIn1;
     corkTriMesh2CorkMesh(in0, &cmIn0);
     corkTriMesh2CorkMesh(in1, &cmIn1);
     
     cmIn0.disjointUnion(cmIn1);
-    cmIn0.resolveIntersections();
+    cmIn0.resolveIntersections(&ctx);
     
     corkMesh2CorkTriMesh(&cmIn0, out);
 }
 
+void computeBooleans(
+    CorkTriMesh in0, CorkTriMesh in1,
+    CorkTriMesh *union_out, CorkTriMesh *diff_out,
+    CorkTriMesh *isct_out,  CorkTriMesh *xor_out
+) {
+    CorkContext ctx;
+    CorkMesh cmIn0, cmIn1;
+    corkTriMesh2CorkMesh(in0, &cmIn0);
+    corkTriMesh2CorkMesh(in1, &cmIn1);
+    
+    CorkMesh cmUnion, cmDiff, cmIsct, cmXor;
+    cmIn0.boolMulti(cmIn1, &ctx,
+                    (union_out)? &cmUnion : NULL,
+                    (diff_out)?  &cmDiff  : NULL,
+                    (isct_out)?  &cmIsct  : NULL,
+                    (xor_out)?   &cmXor   : NULL);
+    
+    if(union_out)   corkMesh2CorkTriMesh(&cmUnion, union_out);
+    if(diff_out)    corkMesh2CorkTriMesh(&cmDiff,  diff_out);
+    if(isct_out)    corkMesh2CorkTriMesh(&cmIsct,  isct_out);
+    if(xor_out)     corkMesh2CorkTriMesh(&cmXor,   xor_out);
+}
+
+// check the client's expression, and translate it for the mesh code
+static bool corkCSG2Expr(
+    uint n_operands, uint n_nodes, const CorkCSGNode *nodes,
+    std::vector<CSGNode> *expr
+) {
+    if(n_operands == 0 || n_nodes == 0) {
+        CORK_ERROR("empty CSG expression input to Cork routine.");
+        return false;
+    }
+    
+    expr->resize(n_nodes);
+    for(uint k=0; k<n_nodes; k++) {
+        const CorkCSGNode &in = nodes[k];
+        CSGNode &node = (*expr)[k];
+        switch(in.op) {
+        case CORK_CSG_OPERAND:              node.op = CSGNode::OPERAND; break;
+        case CORK_CSG_UNION:                node.op = CSGNode::UNION;   break;
+        case CORK_CSG_DIFFERENCE:           node.op = CSGNode::DIFF;    break;
+        case CORK_CSG_INTERSECTION:         node.op = CSGNode::ISCT;    break;
+        case CORK_CSG_SYMMETRIC_DIFFERENCE: node.op = CSGNode::XOR;     break;
+        default:
+            CORK_ERROR("CSG expression input to Cork routine has a node "
+                       "with an unknown operation.");
+            return false;
+        }
+        node.operand    = in.operand;
+        node.left       = in.left;
+        node.right      = in.right;
+        
+        if(node.op == CSGNode::OPERAND) {
+            if(node.operand >= n_operands) {
+                CORK_ERROR("CSG expression input to Cork routine refers "
+                           "to an operand which doesn't exist.");
+                return false;
+            }
+        } else if(node.left >= k || node.right >= k) {
+            CORK_ERROR("CSG expression input to Cork routine has a node "
+                       "which doesn't refer to nodes earlier in the list.");
+            return false;
+        }
+    }
+    return true;
+}
+
+void computeCSG(
+    uint n_operands, const CorkTriMesh *operands,
+    uint n_nodes, const CorkCSGNode *nodes, CorkTriMesh *out
+) {
+    CorkContext ctx;
+    std::vector<CSGNode> expr;
+    if(!corkCSG2Expr(n_operands, n_nodes, nodes, &expr)) {
+        CorkMesh empty;
+        corkMesh2CorkTriMesh(&empty, out);
+        return;
+    }
+    
+    std::vector<CorkMesh> cmIns(n_operands);
+    std::vector<const CorkMesh*> rhs;
+    for(uint k=0; k<n_operands; k++) {
+        corkTriMesh2CorkMesh(operands[k], &cmIns[k]);
+        if(k > 0)   rhs.push_back(&cmIns[k]);
+    }
+    
+    cmIns[0].boolCSG(rhs, expr, &ctx);
+    
+    corkMesh2CorkTriMesh(&cmIns[0], out);
+}
+
+
+
+CorkContext* newCorkContext()
+{
+    return new CorkContext();
+}
+
+void freeCorkContext(CorkContext *ctx)
+{
+    delete ctx;
+}
+
+void seedCorkContext(CorkContext *ctx, unsigned long long seed)
+{
+    ctx->random.reseed(seed);
+}
+
+void setCorkOperandValidation(CorkContext *ctx, bool validate)
+{
+    ctx->validate_operands = validate;
+}
+
+void setCorkThreadCount(CorkContext *ctx, uint n_threads)
+{
+    ctx->n_threads = n_threads;
+}
+
+void setCorkBVHWidth(CorkContext *ctx, uint width)
+{
+    if(width == 2 || width == 4 || width == 8)
+        ctx->bvh_width = width;
+}
+
+void getCorkStats(const CorkContext *ctx, CorkStats *stats)
+{
+    stats->predicate_calls  = ctx->arith.callcount;
+    stats->exact_fallbacks  = ctx->arith.exact_count;
+    stats->degeneracies     = ctx->arith.degeneracy_count;
+    stats->bvh_builds       = ctx->bvh.builds;
+    stats->bvh_nodes        = ctx->bvh.nodes;
+    stats->bvh_build_time   = ctx->bvh.build_time;
+    stats->bvh_visits       = ctx->bvh.visits;
+    stats->bvh_candidates   = ctx->bvh.candidates;
+}
+
+
+// the derived data is everything about an operand which doesn't
+// depend on what it's going to be combined with: its bounding box,
+// and whether it's solid, once that's been asked.  (the hierarchies
+// an operation builds can't be kept here.  They're either built over
+// only the triangles near the other operand, with boxes padded by
+// the quantization grid of both, or over the pieces left after the
+// intersections are resolved.  Each operation also copies in0's mesh,
+// but that copy is where the result gets built)
+struct CorkPreparedMesh
+{
+    CorkMesh    mesh;
+    BBox3d      bbox;
+    
+    // filled in by the first isSolidPrepared() call
+    mutable std::once_flag  solid_once;
+    mutable bool            self_intersecting;
+    mutable bool            closed;
+    
+    void prepare() {
+        bbox = BBox3d();
+        mesh.for_verts([&](CorkVertex &v) {
+            bbox = convex(bbox, BBox3d(v.pos, v.pos));
+        });
+    }
+};
+
+static CorkPreparedMesh* newPrepared(CorkMesh &&mesh)
+{
+    CorkPreparedMesh *result = new CorkPreparedMesh();
+    result->mesh = std::move(mesh);
+    result->prepare();
+    return result;
+}
+
+CorkPreparedMesh* prepareCorkMesh(CorkTriMesh in)
+{
+    CorkMesh mesh;
+    corkTriMesh2CorkMesh(in, &mesh);
+    return newPrepared(std::move(mesh));
+}
+
+void freeCorkPreparedMesh(CorkPreparedMesh *mesh)
+{
+    delete mesh;
+}
+
+void extractCorkTriMesh(const CorkPreparedMesh *mesh, CorkTriMesh *out)
+{
+    corkMesh2CorkTriMesh(&mesh->mesh, out);
+}
+
+bool isSolidPrepared(const CorkPreparedMesh *prepared, CorkContext *ctx)
+{
+    std::call_once(prepared->solid_once, [&]() {
+        CorkContext temp_ctx;
+        if(!ctx) ctx = &temp_ctx;
+        // neither test modifies the mesh
+        CorkMesh &mesh = const_cast<CorkMesh&>(prepared->mesh);
+        prepared->self_intersecting = mesh.isSelfIntersecting(ctx);
+        prepared->closed            = mesh.isClosed();
+    });
+    
+    bool solid = true;
+    
+    if(prepared->self_intersecting) {
+        CORK_ERROR("isSolidPrepared() was given a self-intersecting mesh");
+        solid = false;
+    }
+    
+    if(!prepared->closed) {
+        CORK_ERROR("isSolidPrepared() was given a non-closed mesh");
+        solid = false;
+    }
+    
+    return solid;
+}
+
+// When the bounding boxes of two solids don't overlap,
+// neither can intersect or contain the other,
+// so every operation reduces to a copy
+static inline bool separated(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1
+) {
+    return !hasIsct(in0->bbox, in1->bbox);
+}
+
+void computeUnionPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh result(in0->mesh);
+    if(separated(in0, in1))     result.disjointUnion(in1->mesh);
+    else                        result.boolUnion(in1->mesh, ctx);
+    *out = newPrepared(std::move(result));
+}
+
+void computeDifferencePrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh result(in0->mesh);
+    if(!separated(in0, in1))    result.boolDiff(in1->mesh, ctx);
+    *out = newPrepared(std::move(result));
+}
+
+void computeIntersectionPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh result;
+    if(!separated(in0, in1)) {
+        result = in0->mesh;
+        result.boolIsct(in1->mesh, ctx);
+    }
+    *out = newPrepared(std::move(result));
+}
+
+void computeSymmetricDifferencePrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh result(in0->mesh);
+    if(separated(in0, in1))     result.disjointUnion(in1->mesh);
+    else                        result.boolXor(in1->mesh, ctx);
+    *out = newPrepared(std::move(result));
+}
+
+void resolveIntersectionsPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **out, CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh result(in0->mesh);
+    result.disjointUnion(in1->mesh);
+    if(!separated(in0, in1))    result.resolveIntersections(ctx);
+    *out = newPrepared(std::move(result));
+}
+
+void computeBooleansPrepared(
+    const CorkPreparedMesh *in0, const CorkPreparedMesh *in1,
+    CorkPreparedMesh **union_out, CorkPreparedMesh **diff_out,
+    CorkPreparedMesh **isct_out,  CorkPreparedMesh **xor_out,
+    CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh cmUnion, cmDiff, cmIsct, cmXor;
+    if(separated(in0, in1)) {
+        // same shortcuts as the single operations
+        if(union_out || xor_out) {
+            cmUnion = in0->mesh;
+            cmUnion.disjointUnion(in1->mesh);
+            if(xor_out) cmXor = cmUnion;
+        }
+        if(diff_out)    cmDiff = in0->mesh;
+    } else {
+        in0->mesh.boolMulti(in1->mesh, ctx,
+                            (union_out)? &cmUnion : NULL,
+                            (diff_out)?  &cmDiff  : NULL,
+                            (isct_out)?  &cmIsct  : NULL,
+                            (xor_out)?   &cmXor   : NULL);
+    }
+    
+    if(union_out)   *union_out  = newPrepared(std::move(cmUnion));
+    if(diff_out)    *diff_out   = newPrepared(std::move(cmDiff));
+    if(isct_out)    *isct_out   = newPrepared(std::move(cmIsct));
+    if(xor_out)     *xor_out    = newPrepared(std::move(cmXor));
+}
+
+void computeCSGPrepared(
+    uint n_operands, const CorkPreparedMesh * const *operands,
+    uint n_nodes, const CorkCSGNode *nodes,
+    CorkPreparedMesh **out, CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    std::vector<CSGNode> expr;
+    if(!corkCSG2Expr(n_operands, n_nodes, nodes, &expr)) {
+        *out = newPrepared(CorkMesh());
+        return;
+    }
+    
+    CorkMesh result(operands[0]->mesh);
+    std::vector<const CorkMesh*> rhs;
+    for(uint k=1; k<n_operands; k++)
+        rhs.push_back(&operands[k]->mesh);
+    result.boolCSG(rhs, expr, ctx);
+    *out = newPrepared(std::move(result));
+}
+
+
+bool isSolidView(CorkMeshView view, CorkContext *ctx)
+{
+    CorkPreparedMesh prepared;
+    corkView2CorkMesh(view, &prepared.mesh);
+    return isSolidPrepared(&prepared, ctx);
+}
+
+void computeUnionView(
+    CorkMeshView in0, CorkMeshView in1, CorkMeshSink out,
+    CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh cmIn0, cmIn1;
+    corkView2CorkMesh(in0, &cmIn0);
+    corkView2CorkMesh(in1, &cmIn1);
+    
+    cmIn0.boolUnion(cmIn1, ctx);
+    
+    corkMesh2CorkSink(&cmIn0, out);
+}
+
+void computeDifferenceView(
+    CorkMeshView in0, CorkMeshView in1, CorkMeshSink out,
+    CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh cmIn0, cmIn1;
+    corkView2CorkMesh(in0, &cmIn0);
+    corkView2CorkMesh(in1, &cmIn1);
+    
+    cmIn0.boolDiff(cmIn1, ctx);
+    
+    corkMesh2CorkSink(&cmIn0, out);
+}
+
+void computeIntersectionView(
+    CorkMeshView in0, CorkMeshView in1, CorkMeshSink out,
+    CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh cmIn0, cmIn1;
+    corkView2CorkMesh(in0, &cmIn0);
+    corkView2CorkMesh(in1, &cmIn1);
+    
+    cmIn0.boolIsct(cmIn1, ctx);
+    
+    corkMesh2CorkSink(&cmIn0, out);
+}
+
+void computeSymmetricDifferenceView(
+    CorkMeshView in0, CorkMeshView in1, CorkMeshSink out,
+    CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh cmIn0, cmIn1;
+    corkView2CorkMesh(in0, &cmIn0);
+    corkView2CorkMesh(in1, &cmIn1);
+    
+    cmIn0.boolXor(cmIn1, ctx);
+    
+    corkMesh2CorkSink(&cmIn0, out);
+}
+
+void resolveIntersectionsView(
+    CorkMeshView in0, CorkMeshView in1, CorkMeshSink out,
+    CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh cmIn0, cmIn1;
+    corkView2CorkMesh(in0, &cmIn0);
+    corkView2CorkMesh(in1, &cmIn1);
+    
+    cmIn0.disjointUnion(cmIn1);
+    cmIn0.resolveIntersections(ctx);
+    
+    corkMesh2CorkSink(&cmIn0, out);
+}
+
+void computeBooleansView(
+    CorkMeshView in0, CorkMeshView in1,
+    const CorkMeshSink *union_out, const CorkMeshSink *diff_out,
+    const CorkMeshSink *isct_out,  const CorkMeshSink *xor_out,
+    CorkContext *ctx
+) {
+    CorkContext temp_ctx;
+    if(!ctx) ctx = &temp_ctx;
+    
+    CorkMesh cmIn0, cmIn1;
+    corkView2CorkMesh(in0, &cmIn0);
+    corkView2CorkMesh(in1, &cmIn1);
+    
+    CorkMesh cmUnion, cmDiff, cmIsct, cmXor;
+    cmIn0.boolMulti(cmIn1, ctx,
+                    (union_out)? &cmUnion : NULL,
+                    (diff_out)?  &cmDiff  : NULL,
+                    (isct_out)?  &cmIsct  : NULL,
+                    (xor_out)?   &cmXor   : NULL);
+    
+    if(union_out)   corkMesh2CorkSink(&cmUnion, *union_out);
+    if(diff_out)    corkMesh2CorkSink(&cmDiff,  *diff_out);
+    if(isct_out)    corkMesh2CorkSink(&cmIsct,  *isct_out);
+    if(xor_out)     corkMesh2CorkSink(&cmXor,   *xor_out);
+}
+
+CorkPreparedMesh* prepareCorkMeshView(CorkMeshView view)
+{
+    CorkMesh mesh;
+    corkView2CorkMesh(view, &mesh);
+    return newPrepared(std::move(mesh));
+}
+
+void extractCorkMeshView(const CorkPreparedMesh *mesh, CorkMeshSink out)
+{
+    corkMesh2CorkSink(&mesh->mesh, out);
+}
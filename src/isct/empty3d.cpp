@@ -28,23 +28,16 @@
 #include "ext4.h"
 #include "absext4.h"
 #include "fixext4.h"
-#include "gmpext4.h"
-
-#include "quantization.h"
+#include "perturbext4.h"
 
 #include <cfloat>
 
 namespace Empty3d {
 
-// externalized counters...
-int degeneracy_count = 0;
-int exact_count = 0;
-int callcount = 0;
-
 using namespace Ext4;
 using namespace AbsExt4;
 using namespace FixExt4;
-using namespace GMPExt4;
+using namespace PerturbExt4;
 
 void toExt(Ext4_1 &out, const Vec3d &in)
 {
@@ -73,49 +66,55 @@ void toVec3d(Vec3d &out, const Ext4_1 &in)
 
 const static int IN_BITS = Quantization::BITS + 1; // +1 for sign bit
 
-void toFixExt(FixExt4_1<IN_BITS> &out, const Vec3d &in)
+void toFixExt(FixExt4_1<IN_BITS> &out, const Vec3d &in,
+              const Quantization::Quantizer &quant)
 {
-    out.e0 = BitInt<IN_BITS>::Rep(Quantization::quantize2int(in[0]));
-    out.e1 = BitInt<IN_BITS>::Rep(Quantization::quantize2int(in[1]));
-    out.e2 = BitInt<IN_BITS>::Rep(Quantization::quantize2int(in[2]));
+    out.e0 = BitInt<IN_BITS>::Rep(quant.quantize2int(in[0]));
+    out.e1 = BitInt<IN_BITS>::Rep(quant.quantize2int(in[1]));
+    out.e2 = BitInt<IN_BITS>::Rep(quant.quantize2int(in[2]));
     out.e3 = BitInt<IN_BITS>::Rep(1);
 }
 
-void toGmpExt(GmpExt4_1 &out, const Vec3d &in)
+// Simulation of Simplicity:  each coordinate of vertex id is moved by
+// its own infinitesimal (see perturbext4.h).  Since that only depends
+// on the id, all predicates agree on one consistent configuration.
+void toPerturbExt(PerturbExt4_1 &out, const Vec3d &in, uint id,
+                  uint degree, const Quantization::Quantizer &quant)
+{
+    unsigned long long k = 3ULL * id;
+    out.e0 = EpsPoly(quant.quantize2int(in.x), k,     degree);
+    out.e1 = EpsPoly(quant.quantize2int(in.y), k + 1, degree);
+    out.e2 = EpsPoly(quant.quantize2int(in.z), k + 2, degree);
+    out.e3 = EpsPoly(1);
+}
+
+// the limit of the perturbed point as the infinitesimals go to zero
+void toVec3d(Vec3d &out, const PerturbExt4_1 &in,
+             const Quantization::Quantizer &quant)
 {
-    out.e0 = Quantization::quantize2int(in.x);
-    out.e1 = Quantization::quantize2int(in.y);
-    out.e2 = Quantization::quantize2int(in.z);
-    out.e3 = 1;
+    ENSURE(sign(in.e3) != 0);
+    const EpsMonomial &m = in.e3.terms.begin()->first;
+    const EpsPoly *coords[3] = { &in.e0, &in.e1, &in.e2 };
+    double w = in.e3.terms.begin()->second.get_d();
+    for(uint i=0; i<3; i++) {
+        double x = coeff(*coords[i], m).get_d();
+        out.v[i] = quant.RESHRINK * (x / w);
+    }
 }
 
-void toVec3d(Vec3d &out, const GmpExt4_1 &in)
+template<int BITS>
+void toVec3d(Vec3d &out, const FixExt4_1<BITS> &in,
+             const Quantization::Quantizer &quant)
 {
     Vec4d tmp;
-    tmp.x = in.e0.get_d();
-    tmp.y = in.e1.get_d();
-    tmp.z = in.e2.get_d();
-    tmp.w = in.e3.get_d();
+    tmp.x = approximate(in.e0);
+    tmp.y = approximate(in.e1);
+    tmp.z = approximate(in.e2);
+    tmp.w = approximate(in.e3);
     tmp /= tmp.w;
     for(uint k=0; k<3; k++)
-        out.v[k] = Quantization::RESHRINK * tmp.v[k];
-}
-
-//template<int BITS>
-//void appxFixExt(Vec3d &out, FixExt4_1<BITS> &in)
-//{
-//    Vec4d temp;
-//    temp[0] = approximate(in.e0);
-//    temp[1] = approximate(in.e1);
-//    temp[2] = approximate(in.e2);
-//    temp[3] = approximate(in.e3);
-//    std::cout << "appx " << temp << std::endl;
-//    for(uint k=0; k<3; k++) {
-//        out[k] = temp[k];
-//        out[k] /= temp[3];
-//        out[k] *= Quantization::RESHRINK;
-//    }
-//}
+        out.v[k] = quant.RESHRINK * tmp.v[k];
+}
 
 const static double EPS                 = DBL_EPSILON;
 const static double EPS2                = EPS * EPS;
@@ -125,9 +124,9 @@ inline bool filterCheck(double val, double absval, double coeff) {
 }
 
 
-bool isEmpty(const TriEdgeIn &input)
+bool isEmpty(ExactArithmeticContext *ctx, const TriEdgeIn &input)
 {
-    callcount++;
+    ctx->callcount++;
     
     Ext4_2 temp_e2;
     
@@ -172,7 +171,7 @@ bool isEmpty(const TriEdgeIn &input)
            (inner(e_ext2, a_e1) < 0.0);
 }
 
-Vec3d coords(const TriEdgeIn &input)
+Vec3d coords(ExactArithmeticContext *, const TriEdgeIn &input)
 {
     Ext4_2 temp_e2;
     
@@ -203,11 +202,42 @@ Vec3d coords(const TriEdgeIn &input)
     return result;
 }
 
-const static double COEFF_IT12_PISCT    = 10.0*EPS + 64.0*EPS2;
-const static double COEFF_IT12_S1       = 20.0*EPS + 256.0*EPS2;
-const static double COEFF_IT12_S2       = 24.0*EPS + 512.0*EPS2;
+const double COEFF_IT12_PISCT           = 10.0*EPS + 64.0*EPS2;
+const double COEFF_IT12_S1              = 20.0*EPS + 256.0*EPS2;
+const double COEFF_IT12_S2              = 24.0*EPS + 512.0*EPS2;
 
-int emptyFilter(const TriEdgeIn &input)
+void triPlane(TriPlane &out, const TriIn &tri)
+{
+    Ext4_2 temp2;                           AbsExt4_2 ktemp2;
+    Ext4_1 tp[3];                           AbsExt4_1 ktp[3];
+    Ext4_3 t_ext3;                          AbsExt4_3 kt_ext3;
+    for(int i=0; i<3; i++) {
+        toExt(tp[i], tri.p[i]);             abs(ktp[i], tp[i]);
+    }
+    join(temp2,  tp[0], tp[1]);             join(ktemp2,  ktp[0], ktp[1]);
+    join(t_ext3, temp2, tp[2]);             join(kt_ext3, ktemp2, ktp[2]);
+    for(int k=0; k<4; k++) {
+        out.t[k]    = t_ext3.v[k];
+        out.kt[k]   = kt_ext3.v[k];
+    }
+}
+
+void edgeLine(EdgeLine &out, const EdgeIn &edge)
+{
+    Ext4_1 ep[2];                           AbsExt4_1 kep[2];
+    Ext4_2 e_ext2;                          AbsExt4_2 ke_ext2;
+    for(int i=0; i<2; i++) {
+        toExt(ep[i], edge.p[i]);            abs(kep[i], ep[i]);
+    }
+    join(e_ext2, ep[0], ep[1]);             join(ke_ext2, kep[0], kep[1]);
+    for(int k=0; k<6; k++) {
+        out.e[k]    = e_ext2.v[k];
+        out.ke[k]   = ke_ext2.v[k];
+    }
+}
+
+int emptyFilter(const TriEdgeIn &input,
+                const TriPlane &tri_plane, const EdgeLine &edge_line)
 {
     Ext4_2 temp2;                           AbsExt4_2 ktemp2;
     Ext4_1 ep[2];                           AbsExt4_1 kep[2];
@@ -222,10 +252,13 @@ int emptyFilter(const TriEdgeIn &input)
     for(int i=0; i<3; i++) {
         toExt(tp[i], input.tri.p[i]);       abs(ktp[i], tp[i]);
     }
-    // form the edge and triangle
-    join(e_ext2, ep[0], ep[1]);             join(ke_ext2, kep[0], kep[1]);
-    join(temp2,  tp[0], tp[1]);             join(ktemp2,  ktp[0], ktp[1]);
-    join(t_ext3, temp2, tp[2]);             join(kt_ext3, ktemp2, ktp[2]);
+    // and the edge and triangle
+    for(int k=0; k<6; k++) {
+        e_ext2.v[k] = edge_line.e[k];       ke_ext2.v[k] = edge_line.ke[k];
+    }
+    for(int k=0; k<4; k++) {
+        t_ext3.v[k] = tri_plane.t[k];       kt_ext3.v[k] = tri_plane.kt[k];
+    }
     
     // compute the point of intersection
     Ext4_1 pisct;                           AbsExt4_1 kpisct;
@@ -278,7 +311,135 @@ int emptyFilter(const TriEdgeIn &input)
         return -1; // i.e. false (the intersection is not empty)
 }
 
-bool exactFallback(const TriEdgeIn &input)
+int emptyFilter(const TriEdgeIn &input)
+{
+    TriPlane tri_plane;
+    EdgeLine edge_line;
+    triPlane(tri_plane, input.tri);
+    edgeLine(edge_line, input.edge);
+    return emptyFilter(input, tri_plane, edge_line);
+}
+
+void perturbedIsct(PerturbExt4_1 &pisct,
+                   PerturbExt4_1 ep[2], PerturbExt4_1 tp[3],
+                   PerturbExt4_2 &e, PerturbExt4_3 &t, uint degree,
+                   ExactArithmeticContext *ctx, const TriEdgeIn &input)
+{
+    for(uint i=0; i<2; i++)
+        toPerturbExt(ep[i], input.edge.p[i], input.edge.id[i],
+                     degree, ctx->quantizer);
+    for(uint i=0; i<3; i++)
+        toPerturbExt(tp[i], input.tri.p[i], input.tri.id[i],
+                     degree, ctx->quantizer);
+    
+    PerturbExt4_2                       temp;
+    join(e, ep[0], ep[1]);
+    join(temp, tp[0], tp[1]);
+    join(t,    temp,  tp[2]);
+    meet(pisct, e, t);
+}
+
+// The perturbed test, keeping terms up to the given degree in the eps.
+// Returns 1 if empty, 0 if not, and -1 if those terms don't decide it.
+static int perturbedEmpty(ExactArithmeticContext *ctx,
+                          const TriEdgeIn &input, uint degree)
+{
+    PerturbExt4_1                       ep[2], tp[3];
+    PerturbExt4_2                       e;
+    PerturbExt4_3                       t;
+    PerturbExt4_1                       pisct;
+    perturbedIsct(pisct, ep, tp, e, t, degree, ctx, input);
+    
+    int e3sign = sign(pisct.e3);
+    if(e3sign == 0)
+        return -1;
+    if(e3sign < 0)
+        neg(pisct, pisct);
+    
+    // process edge
+    PerturbExt4_2                       ae0, ae1;
+    join(ae0, pisct, ep[1]);
+    join(ae1, ep[0], pisct);
+    int s0 = sign(inner(e, ae0));
+    int s1 = sign(inner(e, ae1));
+    if(s0 < 0 || s1 < 0)
+        return 1;
+    
+    // process triangle
+    PerturbExt4_3                       at0, at1, at2;
+    PerturbExt4_2                       temp;
+    join(temp, pisct, tp[1]);       join(at0, temp, tp[2]);
+    join(temp, tp[0], pisct);       join(at1, temp, tp[2]);
+    join(temp, tp[0], tp[1]);       join(at2, temp, pisct);
+    int t0 = sign(inner(t, at0));
+    int t1 = sign(inner(t, at1));
+    int t2 = sign(inner(t, at2));
+    if(t0 < 0 || t1 < 0 || t2 < 0)
+        return 1;
+    
+    if(s0 == 0 || s1 == 0 || t0 == 0 || t1 == 0 || t2 == 0)
+        return -1;
+    return 0;
+}
+
+// decide a degenerate case using the symbolic perturbation
+bool perturbedFallback(ExactArithmeticContext *ctx, const TriEdgeIn &input)
+{
+    ctx->degeneracy_count++;
+    for(uint i=0; i<3; i++)
+        ctx->degenerate_ids.push_back(input.tri.id[i]);
+    for(uint i=0; i<2; i++)
+        ctx->degenerate_ids.push_back(input.edge.id[i]);
+    
+    // The tests have degree at most 10, so after that the result can
+    // only be undecided if one of them is identically zero.  That needs
+    // the edge and triangle to share a vertex, which the caller rules out.
+    int empty = -1;
+    for(uint degree=1; empty < 0 && degree <= 10; degree++)
+        empty = perturbedEmpty(ctx, input, degree);
+    ENSURE(empty >= 0);
+    return empty;
+}
+
+// The edge lies in the plane of the triangle.  For coplanar points
+// inner(t, a) has the sign of a's orientation within that plane, so
+// look for a separating line: one of the triangle's sides or the edge.
+template<int TRI_BITS>
+static bool coplanarSeparated(const FixExt4_1<IN_BITS> ep[2],
+                              const FixExt4_1<IN_BITS> tp[3],
+                              const FixExt4_2<2*IN_BITS + 1> &e,
+                              const FixExt4_3<TRI_BITS> &t)
+{
+    FixExt4_2<2*IN_BITS + 1>            temp;
+    FixExt4_3<TRI_BITS>                 a;
+    typename BitInt<2*TRI_BITS + 2>::Rep test;
+    
+    // both endpoints beyond the same side of the triangle?
+    for(uint k=0; k<3; k++) {
+        uint outside = 0;
+        for(uint i=0; i<2; i++) {
+            join(temp,  ((k==0)? ep[i] : tp[0]),
+                        ((k==1)? ep[i] : tp[1]));
+            join(a, temp, ((k==2)? ep[i] : tp[2]));
+            inner(test, t, a);
+            if(sign(test) < 0)
+                outside++;
+        }
+        if(outside == 2)
+            return true;
+    }
+    
+    // the whole triangle strictly to one side of the edge?
+    int side[3];
+    for(uint j=0; j<3; j++) {
+        join(a, e, tp[j]);
+        inner(test, t, a);
+        side[j] = sign(test);
+    }
+    return side[0] != 0 && side[0] == side[1] && side[0] == side[2];
+}
+
+bool exactFallback(ExactArithmeticContext *ctx, const TriEdgeIn &input)
 {
     // How many bits do we need for various intermediary values?
     // Here we label the amount with the relevant type (i.e. EXT2)
@@ -295,9 +456,9 @@ bool exactFallback(const TriEdgeIn &input)
     FixExt4_1<IN_BITS>                  ep[2];
     FixExt4_1<IN_BITS>                  tp[3];
     for(uint i=0; i<2; i++)
-        toFixExt(ep[i], input.edge.p[i]);
+        toFixExt(ep[i], input.edge.p[i], ctx->quantizer);
     for(uint i=0; i<3; i++)
-        toFixExt(tp[i], input.tri.p[i]);
+        toFixExt(tp[i], input.tri.p[i], ctx->quantizer);
     
     // construct geometry
     FixExt4_2<LINE_BITS>                e;
@@ -315,8 +476,14 @@ bool exactFallback(const TriEdgeIn &input)
     if(e3sign < 0) {
         neg(pisct, pisct);
     } else if(e3sign == 0) {
-        degeneracy_count++;
-        return true;
+        // the edge is parallel to the triangle; off its plane or
+        // clear of it within the plane, no perturbation can matter
+        if(sign(pisct.e0) != 0 || sign(pisct.e1) != 0 ||
+           sign(pisct.e2) != 0)
+            return true;
+        if(coplanarSeparated(ep, tp, e, t))
+            return true;
+        return perturbedFallback(ctx, input);
     }
     
     // process edge
@@ -353,59 +520,151 @@ bool exactFallback(const TriEdgeIn &input)
     if(sign_e0 == 0 || sign_e1 == 0 ||
        sign_t0 == 0 || sign_t1 == 0 || sign_t2 == 0)
     {
-        degeneracy_count++;
+        return perturbedFallback(ctx, input);
     }
     return false;
 }
 
-bool emptyExact(const TriEdgeIn &input)
+bool emptyExact(ExactArithmeticContext *ctx, const TriEdgeIn &input)
 {
-    callcount++;
+    ctx->callcount++;
     int filter = emptyFilter(input);
     if(filter == 0) {
-        exact_count++;
-        return exactFallback(input);
+        ctx->exact_count++;
+        return exactFallback(ctx, input);
     }
     else
         return filter > 0;
 }
 
-Vec3d coordsExact(const TriEdgeIn &input)
+void TriEdgeBatch::clear()
 {
-    // How many bits do we need for various intermediary values?
-    // Here we label the amount with the relevant type (i.e. EXT2)
-    // and the relevant role
-    //const static int LINE_BITS       = 2*IN_BITS + 1;
-    //const static int TRI_BITS        = LINE_BITS + IN_BITS + 2;
-    //const static int ISCT_BITS       = TRI_BITS + LINE_BITS + 2;
-    //const static int LINE_A_BITS     = ISCT_BITS + IN_BITS + 1;
-    //const static int TRI_A_BITS      = LINE_A_BITS + IN_BITS + 2;
-    //const static int INNER_LINE_BITS = LINE_A_BITS + LINE_BITS + 3;
-    //const static int INNER_TRI_BITS  = TRI_A_BITS + TRI_BITS + 2;
+    for(uint i=0; i<2; i++)
+        for(uint k=0; k<3; k++)
+            edge[i][k].clear();
+    for(uint i=0; i<3; i++)
+        for(uint k=0; k<3; k++)
+            tri[i][k].clear();
+    for(uint k=0; k<4; k++) {
+        plane[k].clear();   kplane[k].clear();
+    }
+    for(uint k=0; k<6; k++) {
+        line[k].clear();    kline[k].clear();
+    }
+    inputs.clear();
+}
+
+void TriEdgeBatch::push_back(const TriEdgeIn &input,
+                             const TriPlane &tri_plane,
+                             const EdgeLine &edge_line)
+{
+    for(uint i=0; i<2; i++)
+        for(uint k=0; k<3; k++)
+            edge[i][k].push_back(input.edge.p[i][k]);
+    for(uint i=0; i<3; i++)
+        for(uint k=0; k<3; k++)
+            tri[i][k].push_back(input.tri.p[i][k]);
+    for(uint k=0; k<4; k++) {
+        plane[k].push_back(tri_plane.t[k]);
+        kplane[k].push_back(tri_plane.kt[k]);
+    }
+    for(uint k=0; k<6; k++) {
+        line[k].push_back(edge_line.e[k]);
+        kline[k].push_back(edge_line.ke[k]);
+    }
+    inputs.push_back(input);
+}
+
+// (the plane and line of input n)
+static void planeAndLine(const TriEdgeBatch &batch, uint n,
+                         TriPlane &tri_plane, EdgeLine &edge_line)
+{
+    for(uint k=0; k<4; k++) {
+        tri_plane.t[k]  = batch.plane[k][n];
+        tri_plane.kt[k] = batch.kplane[k][n];
+    }
+    for(uint k=0; k<6; k++) {
+        edge_line.e[k]  = batch.line[k][n];
+        edge_line.ke[k] = batch.kline[k][n];
+    }
+}
+
+// emptyFilter() on every input of a batch, as many at once as the
+// cpu we're running on can manage; the rest one at a time
+static void emptyFilter(const TriEdgeBatch &batch, int *result)
+{
+    uint n = emptyFilterLanes(batch, 8, result);
+    if(n == 0)
+        n = emptyFilterLanes(batch, 4, result);
+    // (the scalar filter can stop early, so it beats single lanes)
+    for(; n<batch.size(); n++) {
+        TriPlane tri_plane;
+        EdgeLine edge_line;
+        planeAndLine(batch, n, tri_plane, edge_line);
+        result[n] = emptyFilter(batch.inputs[n], tri_plane, edge_line);
+    }
+}
+
+void emptyExact(ExactArithmeticContext *ctx, const TriEdgeBatch &batch,
+                byte *empty)
+{
+    std::vector<int> filter(batch.size());
+    emptyFilter(batch, filter.data());
+    for(uint n=0; n<batch.size(); n++) {
+        ctx->callcount++;
+        if(filter[n] == 0) {
+            ctx->exact_count++;
+            empty[n] = exactFallback(ctx, batch.inputs[n]);
+        }
+        else
+            empty[n] = filter[n] > 0;
+    }
+}
+
+Vec3d coordsExact(ExactArithmeticContext *ctx, const TriEdgeIn &input)
+{
+    // (the same bit counts as exactFallback)
+    const static int LINE_BITS       = 2*IN_BITS + 1;
+    const static int TRI_BITS        = LINE_BITS + IN_BITS + 2;
+    const static int ISCT_BITS       = TRI_BITS + LINE_BITS + 2;
     
     // pull in points
-    GmpExt4_1                           ep[2];
-    GmpExt4_1                           tp[3];
+    FixExt4_1<IN_BITS>                  ep[2];
+    FixExt4_1<IN_BITS>                  tp[3];
     for(uint i=0; i<2; i++)
-        toGmpExt(ep[i], input.edge.p[i]);
+        toFixExt(ep[i], input.edge.p[i], ctx->quantizer);
     for(uint i=0; i<3; i++)
-        toGmpExt(tp[i], input.tri.p[i]);
+        toFixExt(tp[i], input.tri.p[i], ctx->quantizer);
     
     // construct geometry
-    GmpExt4_2                           e;
+    FixExt4_2<LINE_BITS>                e;
     join(e, ep[0], ep[1]);
-    GmpExt4_2                           temp_up;
-    GmpExt4_3                           t;
+    FixExt4_2<LINE_BITS>                temp_up;
+    FixExt4_3<TRI_BITS>                 t;
     join(temp_up, tp[0], tp[1]);
     join(t,     temp_up, tp[2]);
     
     // compute the point of intersection
-    GmpExt4_1                           pisct;
+    FixExt4_1<ISCT_BITS>                pisct;
     meet(pisct, e, t);
     
     // convert to double
     Vec3d result;
-    toVec3d(result, pisct);
+    if(sign(pisct.e3) == 0) {
+        // the edge lies in the plane of the triangle;
+        // take the point the perturbed intersection converges to
+        PerturbExt4_1                   pep[2], ptp[3];
+        PerturbExt4_2                   pe;
+        PerturbExt4_3                   pt;
+        PerturbExt4_1                   ppisct;
+        for(uint degree=1; sign(ppisct.e3) == 0; degree++) {
+            ENSURE(degree <= 5);
+            perturbedIsct(ppisct, pep, ptp, pe, pt, degree, ctx, input);
+        }
+        toVec3d(result, ppisct, ctx->quantizer);
+    } else {
+        toVec3d(result, pisct, ctx->quantizer);
+    }
     //std::cout << result << std::endl;
     return result;
 }
@@ -417,9 +676,9 @@ Vec3d coordsExact(const TriEdgeIn &input)
 
 
 
-bool isEmpty(const TriTriTriIn &input)
+bool isEmpty(ExactArithmeticContext *ctx, const TriTriTriIn &input)
 {
-    callcount++;
+    ctx->callcount++;
     
     Ext4_2 temp_e2;
     
@@ -464,7 +723,7 @@ bool isEmpty(const TriTriTriIn &input)
     return false;
 }
 
-Vec3d coords(const TriTriTriIn &input)
+Vec3d coords(ExactArithmeticContext *, const TriTriTriIn &input)
 {
     Ext4_2 temp_e2;
     
@@ -549,7 +808,74 @@ int emptyFilter(const TriTriTriIn &input)
         return -1; // i.e. false (the intersection is not empty)
 }
 
-bool exactFallback(const TriTriTriIn &input)
+void perturbedIsct(PerturbExt4_1 &pisct,
+                   PerturbExt4_1 p[3][3], PerturbExt4_3 t[3], uint degree,
+                   ExactArithmeticContext *ctx, const TriTriTriIn &input)
+{
+    PerturbExt4_2                       temp;
+    for(uint i=0; i<3; i++) {
+        for(uint j=0; j<3; j++) {
+            toPerturbExt(p[i][j], input.tri[i].p[j], input.tri[i].id[j],
+                         degree, ctx->quantizer);
+        }
+        join(temp, p[i][0], p[i][1]);
+        join(t[i], temp,    p[i][2]);
+    }
+    meet(temp,  t[0], t[1]);
+    meet(pisct, temp, t[2]);
+}
+
+// as for TriEdgeIn
+static int perturbedEmpty(ExactArithmeticContext *ctx,
+                          const TriTriTriIn &input, uint degree)
+{
+    PerturbExt4_1                       p[3][3];
+    PerturbExt4_3                       t[3];
+    PerturbExt4_1                       pisct;
+    perturbedIsct(pisct, p, t, degree, ctx, input);
+    
+    int e3sign = sign(pisct.e3);
+    if(e3sign == 0)
+        return -1;
+    if(e3sign < 0)
+        neg(pisct, pisct);
+    
+    bool undecided = false;
+    for(uint i=0; i<3; i++) {
+        PerturbExt4_3                   a[3];
+        PerturbExt4_2                   temp;
+        join(temp,   pisct, p[i][1]);   join(a[0], temp, p[i][2]);
+        join(temp, p[i][0],   pisct);   join(a[1], temp, p[i][2]);
+        join(temp, p[i][0], p[i][1]);   join(a[2], temp, pisct);
+        for(uint j=0; j<3; j++) {
+            int s = sign(inner(a[j], t[i]));
+            if(s < 0)
+                return 1;
+            if(s == 0)
+                undecided = true;
+        }
+    }
+    return (undecided)? -1 : 0;
+}
+
+// decide a degenerate case using the symbolic perturbation
+bool perturbedFallback(ExactArithmeticContext *ctx, const TriTriTriIn &input)
+{
+    ctx->degeneracy_count++;
+    for(uint k=0; k<3; k++)
+        for(uint i=0; i<3; i++)
+            ctx->degenerate_ids.push_back(input.tri[k].id[i]);
+    
+    // As above; here the tests have degree at most 14, and can only be
+    // identically zero if all three triangles share a vertex.
+    int empty = -1;
+    for(uint degree=1; empty < 0 && degree <= 14; degree++)
+        empty = perturbedEmpty(ctx, input, degree);
+    ENSURE(empty >= 0);
+    return empty;
+}
+
+bool exactFallback(ExactArithmeticContext *ctx, const TriTriTriIn &input)
 {
     // How many bits do we need for various intermediary values?
     // Here we label the amount with the relevant type (i.e. EXT2)
@@ -566,7 +892,7 @@ bool exactFallback(const TriTriTriIn &input)
     FixExt4_3<EXT3_UP_BITS>             t[3];
     for(uint i=0; i<3; i++) {
         for(uint j=0; j<3; j++) {
-            toFixExt(p[i][j], input.tri[i].p[j]);
+            toFixExt(p[i][j], input.tri[i].p[j], ctx->quantizer);
         }
         FixExt4_2<EXT2_UP_BITS>         temp;
         join(temp, p[i][0], p[i][1]);
@@ -585,8 +911,7 @@ bool exactFallback(const TriTriTriIn &input)
     if(e3sign < 0) {
         neg(pisct, pisct);
     } else if(e3sign == 0) {
-        degeneracy_count++;
-        return true;
+        return perturbedFallback(ctx, input);
     }
     
     bool uncertain = false;
@@ -610,58 +935,66 @@ bool exactFallback(const TriTriTriIn &input)
         }
     }
     if(uncertain) {
-        degeneracy_count++;
+        return perturbedFallback(ctx, input);
     }
     return false;
 }
 
-bool emptyExact(const TriTriTriIn &input)
+bool emptyExact(ExactArithmeticContext *ctx, const TriTriTriIn &input)
 {
-    callcount++;
+    ctx->callcount++;
     int filter = emptyFilter(input);
     if(filter == 0) {
-        exact_count++;
-        return exactFallback(input);
+        ctx->exact_count++;
+        return exactFallback(ctx, input);
     }
     else
         return filter > 0;
 }
 
-Vec3d coordsExact(const TriTriTriIn &input)
+Vec3d coordsExact(ExactArithmeticContext *ctx, const TriTriTriIn &input)
 {
-    // How many bits do we need for various intermediary values?
-    // Here we label the amount with the relevant type (i.e. EXT2)
-    // and the relevant role
-    //const static int EXT2_UP_BITS = 2*IN_BITS + 1;
-    //const static int EXT3_UP_BITS = EXT2_UP_BITS + IN_BITS + 2;
-    //const static int EXT2_DN_BITS = 2*EXT3_UP_BITS + 1;
-    //const static int ISCT_BITS    = EXT2_DN_BITS + EXT3_UP_BITS + 2;
-    //const static int EXT2_TA_BITS = ISCT_BITS + IN_BITS + 1;
-    //const static int EXT3_TA_BITS = EXT2_TA_BITS + IN_BITS + 2;
-    //const static int INNER_BITS   = EXT3_TA_BITS + EXT3_UP_BITS + 2;
-    
-    GmpExt4_1                           p[3][3];
-    GmpExt4_3                           t[3];
+    // (the same bit counts as exactFallback)
+    const static int EXT2_UP_BITS = 2*IN_BITS + 1;
+    const static int EXT3_UP_BITS = EXT2_UP_BITS + IN_BITS + 2;
+    const static int EXT2_DN_BITS = 2*EXT3_UP_BITS + 1;
+    const static int ISCT_BITS    = EXT2_DN_BITS + EXT3_UP_BITS + 2;
+    
+    FixExt4_1<IN_BITS>                  p[3][3];
+    FixExt4_3<EXT3_UP_BITS>             t[3];
     for(uint i=0; i<3; i++) {
         for(uint j=0; j<3; j++) {
-            toGmpExt(p[i][j], input.tri[i].p[j]);
+            toFixExt(p[i][j], input.tri[i].p[j], ctx->quantizer);
         }
-        GmpExt4_2                       temp;
+        FixExt4_2<EXT2_UP_BITS>         temp;
         join(temp, p[i][0], p[i][1]);
         join(t[i], temp,    p[i][2]);
     }
     
     // compute the point of intersection
-    GmpExt4_1                           pisct;
+    FixExt4_1<ISCT_BITS>                pisct;
     {
-        GmpExt4_2                       temp;
+        FixExt4_2<EXT2_DN_BITS>         temp;
         meet(temp,  t[0], t[1]);
         meet(pisct, temp, t[2]);
     }
     
     // convert to double
     Vec3d result;
-    toVec3d(result, pisct);
+    if(sign(pisct.e3) == 0) {
+        // the planes do not meet in a single point;
+        // take the point the perturbed intersection converges to
+        PerturbExt4_1                   pp[3][3];
+        PerturbExt4_3                   pt[3];
+        PerturbExt4_1                   ppisct;
+        for(uint degree=1; sign(ppisct.e3) == 0; degree++) {
+            ENSURE(degree <= 9);
+            perturbedIsct(ppisct, pp, pt, degree, ctx, input);
+        }
+        toVec3d(result, ppisct, ctx->quantizer);
+    } else {
+        toVec3d(result, pisct, ctx->quantizer);
+    }
     return result;
 }
 
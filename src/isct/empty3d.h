@@ -26,17 +26,42 @@
 #pragma once
 
 #include "vec.h"
+#include "quantization.h"
+
+#include <vector>
 
 namespace Empty3d {
 
+// Everything the predicates below read or write besides their input:
+// the quantization grid the input lives on, and some statistics.
+// Computations using separate contexts may run concurrently.
+struct ExactArithmeticContext
+{
+    Quantization::Quantizer     quantizer;
+    
+    int degeneracy_count; // count degeneracies encountered
+                          // (these are resolved by symbolic perturbation)
+    int exact_count; // count of filter calls failed
+    int callcount; // total call count
+    // the vertex ids of every input the perturbation had to decide
+    std::vector<uint> degenerate_ids;
+    
+    ExactArithmeticContext() :
+        degeneracy_count(0), exact_count(0), callcount(0) {}
+};
+
+// The ids identify the vertices for the symbolic perturbation.
+// The same vertex must always be given the same id.
 struct TriIn
 {
     Vec3d p[3];
+    uint  id[3];
 };
 
 struct EdgeIn
 {
     Vec3d p[2];
+    uint  id[2];
 };
 
 
@@ -46,23 +71,70 @@ struct TriEdgeIn
     TriIn   tri;
     EdgeIn  edge;
 };
-bool isEmpty(const TriEdgeIn &input);
-Vec3d coords(const TriEdgeIn &input);
-bool emptyExact(const TriEdgeIn &input);
-Vec3d coordsExact(const TriEdgeIn &input);
+bool isEmpty(ExactArithmeticContext *ctx, const TriEdgeIn &input);
+Vec3d coords(ExactArithmeticContext *ctx, const TriEdgeIn &input);
+bool emptyExact(ExactArithmeticContext *ctx, const TriEdgeIn &input);
+Vec3d coordsExact(ExactArithmeticContext *ctx, const TriEdgeIn &input);
+
+// The parts of the TriEdgeIn filter that only depend on the triangle
+// or only on the edge: the plane of the triangle and the line of the
+// edge, with the magnitudes bounding their rounding error.  Computing
+// them once per element saves redoing them for every test it's in.
+struct TriPlane
+{
+    double t[4];    // (as an Ext4_3)
+    double kt[4];   // (as an AbsExt4_3)
+};
+struct EdgeLine
+{
+    double e[6];    // (as an Ext4_2)
+    double ke[6];   // (as an AbsExt4_2)
+};
+void triPlane(TriPlane &out, const TriIn &tri);
+void edgeLine(EdgeLine &out, const EdgeIn &edge);
+
+// Many TriEdgeIn tests, with the coordinates laid out as structure of
+// arrays (edge[i][axis][n] is coordinate axis of edge point i, in
+// input n) so that the floating point filter can run on them in SIMD
+// lanes.  The inputs are kept whole as well, for the exact fallback.
+struct TriEdgeBatch
+{
+    std::vector<double>     edge[2][3];
+    std::vector<double>     tri[3][3];
+    std::vector<double>     plane[4],   kplane[4];  // (TriPlane)
+    std::vector<double>     line[6],    kline[6];   // (EdgeLine)
+    std::vector<TriEdgeIn>  inputs;
+    
+    inline uint size() const { return inputs.size(); }
+    void clear();
+    void push_back(const TriEdgeIn &input,
+                   const TriPlane &tri_plane, const EdgeLine &edge_line);
+};
+// empty[n] = emptyExact(ctx, batch.inputs[n]); only the inputs the
+// filter can't decide are evaluated exactly
+void emptyExact(ExactArithmeticContext *ctx, const TriEdgeBatch &batch,
+                byte *empty);
+
+// The floating point filter by itself: 1 if the input is surely empty,
+// -1 if it surely isn't, 0 if the filter can't tell.  The bounds on
+// its rounding error assume no fused multiply-adds
+int emptyFilter(const TriEdgeIn &input,
+                const TriPlane &tri_plane, const EdgeLine &edge_line);
+extern const double COEFF_IT12_PISCT, COEFF_IT12_S1, COEFF_IT12_S2;
+// emptyFilter() on inputs 0, ..., end-1 of a batch, width at a time in
+// SIMD lanes (width 8 needs AVX-512, 4 needs AVX2), with exactly the
+// scalar results.  end is the largest multiple of width in the batch,
+// or 0 if the cpu we're running on can't do that many lanes
+uint emptyFilterLanes(const TriEdgeBatch &batch, uint width, int *result);
 
 struct TriTriTriIn
 {
     TriIn tri[3];
 };
-bool isEmpty(const TriTriTriIn &input);
-Vec3d coords(const TriTriTriIn &input);
-bool emptyExact(const TriTriTriIn &input);
-Vec3d coordsExact(const TriTriTriIn &input);
-
-extern int degeneracy_count; // count degeneracies encountered
-extern int exact_count; // count of filter calls failed
-extern int callcount; // total call count
+bool isEmpty(ExactArithmeticContext *ctx, const TriTriTriIn &input);
+Vec3d coords(ExactArithmeticContext *ctx, const TriTriTriIn &input);
+bool emptyExact(ExactArithmeticContext *ctx, const TriTriTriIn &input);
+Vec3d coordsExact(ExactArithmeticContext *ctx, const TriTriTriIn &input);
 
 /*
 // exact versions
@@ -0,0 +1,186 @@
+// +-------------------------------------------------------------------------
+// | emptyLanes.cpp
+// | 
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+
+// The TriEdgeIn floating point filter in SIMD lanes.  It lives in its
+// own file so that the vector code doesn't leak its compiler settings
+// into the rest of empty3d.cpp: this file is built with
+// -ffp-contract=off (see the Makefile), and without -Wpsabi.
+#include "empty3d.h"
+
+#include "laneext4.h"
+
+// (the vectors only get passed between functions compiled for the
+//  same instruction set, so the ABI warnings don't apply.  They're
+//  given where the templates get instantiated, at the end of the
+//  file, so they have to be off for all of it)
+#ifdef CORK_VECTOR_LANES
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace Empty3d {
+
+using namespace LaneExt4;
+
+template<class L> inline
+typename Lanes<L>::Mask filterCheck(const L &val, const L &absval,
+                                    double coeff) {
+    return fabs(val) > absval*Lanes<L>::splat(coeff);
+}
+
+// emptyFilter() for inputs n, n+1, ..., n+WIDTH-1 of a batch at once.
+// Rather than returning as soon as the answer is known, every lane
+// runs all of the tests, and the answers are read off at the end
+template<class L> inline __attribute__((always_inline))
+void filterLanes(const TriEdgeBatch &batch, uint n, int *result)
+{
+    typedef Lanes<L>                Ln;
+    typedef typename Ln::Mask       Mask;
+    
+    LaneExt4_2<L> temp2;                    LaneAbsExt4_2<L> ktemp2;
+    LaneExt4_1<L> ep[2];                    LaneAbsExt4_1<L> kep[2];
+    LaneExt4_1<L> tp[3];                    LaneAbsExt4_1<L> ktp[3];
+    LaneExt4_2<L> e_ext2;                   LaneAbsExt4_2<L> ke_ext2;
+    LaneExt4_3<L> t_ext3;                   LaneAbsExt4_3<L> kt_ext3;
+    const std::vector<double> *ln       = batch.line;
+    const std::vector<double> *kln      = batch.kline;
+    const std::vector<double> *pl       = batch.plane;
+    const std::vector<double> *kpl      = batch.kplane;
+    
+    // load the points
+    for(int i=0; i<2; i++) {
+        ep[i].e0 = Ln::load(&batch.edge[i][0][n]);
+        ep[i].e1 = Ln::load(&batch.edge[i][1][n]);
+        ep[i].e2 = Ln::load(&batch.edge[i][2][n]);
+        ep[i].e3 = Ln::splat(1.0);          abs(kep[i], ep[i]);
+    }
+    for(int i=0; i<3; i++) {
+        tp[i].e0 = Ln::load(&batch.tri[i][0][n]);
+        tp[i].e1 = Ln::load(&batch.tri[i][1][n]);
+        tp[i].e2 = Ln::load(&batch.tri[i][2][n]);
+        tp[i].e3 = Ln::splat(1.0);          abs(ktp[i], tp[i]);
+    }
+    // and the edge and triangle
+    e_ext2.e01  = Ln::load(&ln[0][n]);      ke_ext2.e01  = Ln::load(&kln[0][n]);
+    e_ext2.e02  = Ln::load(&ln[1][n]);      ke_ext2.e02  = Ln::load(&kln[1][n]);
+    e_ext2.e03  = Ln::load(&ln[2][n]);      ke_ext2.e03  = Ln::load(&kln[2][n]);
+    e_ext2.e12  = Ln::load(&ln[3][n]);      ke_ext2.e12  = Ln::load(&kln[3][n]);
+    e_ext2.e13  = Ln::load(&ln[4][n]);      ke_ext2.e13  = Ln::load(&kln[4][n]);
+    e_ext2.e23  = Ln::load(&ln[5][n]);      ke_ext2.e23  = Ln::load(&kln[5][n]);
+    t_ext3.e012 = Ln::load(&pl[0][n]);      kt_ext3.e012 = Ln::load(&kpl[0][n]);
+    t_ext3.e013 = Ln::load(&pl[1][n]);      kt_ext3.e013 = Ln::load(&kpl[1][n]);
+    t_ext3.e023 = Ln::load(&pl[2][n]);      kt_ext3.e023 = Ln::load(&kpl[2][n]);
+    t_ext3.e123 = Ln::load(&pl[3][n]);      kt_ext3.e123 = Ln::load(&kpl[3][n]);
+    
+    // compute the point of intersection
+    LaneExt4_1<L> pisct;                    LaneAbsExt4_1<L> kpisct;
+    meet(pisct, e_ext2, t_ext3);            meet(kpisct, ke_ext2, kt_ext3);
+    Mask pisct_ok = filterCheck(pisct.e3, kpisct.e3, COEFF_IT12_PISCT);
+    // need to adjust for negative w-coordinate
+    Mask flip = pisct.e3 < Ln::splat(0.0);
+    pisct.e0 = flip? -pisct.e0 : pisct.e0;
+    pisct.e1 = flip? -pisct.e1 : pisct.e1;
+    pisct.e2 = flip? -pisct.e2 : pisct.e2;
+    pisct.e3 = flip? -pisct.e3 : pisct.e3;
+    
+    // for each of the five tests, whether the filter was
+    // reliable, and whether it put the point outside
+    Mask reliable[5];
+    Mask outside[5];
+    // process edge
+    for(int i=0; i<2; i++) {
+        LaneExt4_2<L> a;                    LaneAbsExt4_2<L> ka;
+        join(a, (i==0)? pisct : ep[0],
+                (i==1)? pisct : ep[1]);
+                                            join(ka, (i==0)? kpisct : kep[0],
+                                                     (i==1)? kpisct : kep[1]);
+        L dot = inner(e_ext2, a);           L kdot = inner(ke_ext2, ka);
+        reliable[i] = filterCheck(dot, kdot, COEFF_IT12_S1);
+        outside[i]  = dot < Ln::splat(0.0);
+    }
+    // process triangle
+    for(int i=0; i<3; i++) {
+        LaneExt4_3<L> a;                    LaneAbsExt4_3<L> ka;
+        join(temp2, (i==0)? pisct : tp[0],
+                    (i==1)? pisct : tp[1]);
+        join(a,     temp2,
+                    (i==2)? pisct : tp[2]);
+                                    join(ktemp2, (i==0)? kpisct : ktp[0],
+                                                 (i==1)? kpisct : ktp[1]);
+                                    join(ka,     ktemp2,
+                                                 (i==2)? kpisct : ktp[2]);
+        L dot = inner(t_ext3, a);           L kdot = inner(kt_ext3, ka);
+        reliable[2+i] = filterCheck(dot, kdot, COEFF_IT12_S2);
+        outside[2+i]  = dot < Ln::splat(0.0);
+    }
+    Mask any_out    = reliable[0] & outside[0];
+    Mask all_sure   = reliable[0];
+    for(int i=1; i<5; i++) {
+        any_out     = any_out | (reliable[i] & outside[i]);
+        all_sure    = all_sure & reliable[i];
+    }
+    
+    for(uint k=0; k<Ln::WIDTH; k++) {
+        if(!Ln::lane(pisct_ok, k))      result[n+k] =  0; // i.e. uncertain
+        else if(Ln::lane(any_out, k))   result[n+k] =  1; // i.e. true
+        else if(!Ln::lane(all_sure, k)) result[n+k] =  0;
+        else                            result[n+k] = -1; // i.e. false
+    }
+}
+
+#ifdef CORK_VECTOR_LANES
+__attribute__((target("avx512f")))
+static void emptyFilterAVX512(const TriEdgeBatch &batch, uint end,
+                              int *result)
+{
+    for(uint n=0; n<end; n+=8)
+        filterLanes<LaneD8>(batch, n, result);
+}
+__attribute__((target("avx2")))
+static void emptyFilterAVX2(const TriEdgeBatch &batch, uint end,
+                            int *result)
+{
+    for(uint n=0; n<end; n+=4)
+        filterLanes<LaneD4>(batch, n, result);
+}
+#endif
+
+uint emptyFilterLanes(const TriEdgeBatch &batch, uint width, int *result)
+{
+#ifdef CORK_VECTOR_LANES
+    static const bool has_avx512 = __builtin_cpu_supports("avx512f");
+    static const bool has_avx2   = __builtin_cpu_supports("avx2");
+    uint end = batch.size() - batch.size() % width;
+    if(width == 8 && has_avx512) {
+        emptyFilterAVX512(batch, end, result);
+        return end;
+    }
+    if(width == 4 && has_avx2) {
+        emptyFilterAVX2(batch, end, result);
+        return end;
+    }
+#endif
+    return 0;
+}
+
+} // end namespace Empty3d
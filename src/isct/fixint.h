@@ -51,6 +51,7 @@
 #include <gmp.h>
 #endif
 
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <string>
@@ -82,6 +83,171 @@ const static unsigned int SIGN_BIT_OFFSET = LIMB_BIT_SIZE-1;
                                 ONES_PATTERN : ZERO_PATTERN)
 #define BITS_TO_LIMBS(n) ((((n)-1)/ LIMB_BIT_SIZE)+1)
 
+
+// The numbers the predicates use are only a few limbs long, and at
+// that size GMP's general purpose mpn_ routines spend most of their
+// time on call overhead.  When the compiler has a double limb integer
+// type, numbers of up to FIXINT_INLINE_LIMBS limbs are handled by the
+// inline loops below instead (the sizes are template parameters, so
+// these unroll into straight mul/adc code), and anything longer goes
+// to GMP.
+// Each limbXXX function does the same as the mpn_XXX routine.
+#ifndef FIXINT_INLINE_LIMBS
+#if defined(__SIZEOF_INT128__) && GMP_NUMB_BITS == 64 && GMP_NAIL_BITS == 0
+#define FIXINT_INLINE_LIMBS 8
+#else
+#define FIXINT_INLINE_LIMBS 0
+#endif
+#endif
+#if FIXINT_INLINE_LIMBS > 0
+typedef unsigned __int128 DoubleLimb;
+#endif
+#if defined(__GNUC__) && (__GNUC__ >= 8 || defined(__clang__))
+#define FIXINT_UNROLL _Pragma("GCC unroll 16")
+#else
+#define FIXINT_UNROLL
+#endif
+
+template<int N>
+inline void limbCopyi(mp_limb_t *out, const mp_limb_t *in)
+{
+    for(int i=0; i<N; i++)
+        out[i] = in[i];
+}
+
+template<int N>
+inline mp_limb_t limbAddN(mp_limb_t *out,
+                          const mp_limb_t *lhs, const mp_limb_t *rhs)
+{
+#if FIXINT_INLINE_LIMBS > 0
+    if(N <= FIXINT_INLINE_LIMBS) {
+        DoubleLimb acc = 0;
+        FIXINT_UNROLL
+        for(int i=0; i<N; i++) {
+            acc    += DoubleLimb(lhs[i]) + rhs[i];
+            out[i]  = mp_limb_t(acc);
+            acc   >>= LIMB_BIT_SIZE;
+        }
+        return mp_limb_t(acc);
+    }
+#endif
+    return mpn_add_n(out, lhs, rhs, N);
+}
+
+// (Nlhs > Nrhs)
+template<int Nlhs, int Nrhs>
+inline mp_limb_t limbAdd(mp_limb_t *out,
+                         const mp_limb_t *lhs, const mp_limb_t *rhs)
+{
+#if FIXINT_INLINE_LIMBS > 0
+    if(Nlhs <= FIXINT_INLINE_LIMBS) {
+        DoubleLimb acc = 0;
+        FIXINT_UNROLL
+        for(int i=0; i<Nrhs; i++) {
+            acc    += DoubleLimb(lhs[i]) + rhs[i];
+            out[i]  = mp_limb_t(acc);
+            acc   >>= LIMB_BIT_SIZE;
+        }
+        FIXINT_UNROLL
+        for(int i=Nrhs; i<Nlhs; i++) {
+            acc    += lhs[i];
+            out[i]  = mp_limb_t(acc);
+            acc   >>= LIMB_BIT_SIZE;
+        }
+        return mp_limb_t(acc);
+    }
+#endif
+    return mpn_add(out, lhs, Nlhs, rhs, Nrhs);
+}
+
+template<int N>
+inline mp_limb_t limbSub1(mp_limb_t *out, const mp_limb_t *in,
+                          mp_limb_t borrow)
+{
+#if FIXINT_INLINE_LIMBS > 0
+    if(N <= FIXINT_INLINE_LIMBS) {
+        FIXINT_UNROLL
+        for(int i=0; i<N; i++) {
+            mp_limb_t x = in[i];
+            out[i]      = x - borrow;
+            borrow      = (x < borrow);
+        }
+        return borrow;
+    }
+#endif
+    return mpn_sub_1(out, in, N, borrow);
+}
+
+template<int N>
+inline void limbNeg(mp_limb_t *out, const mp_limb_t *in)
+{
+#if FIXINT_INLINE_LIMBS > 0
+    if(N <= FIXINT_INLINE_LIMBS) {
+        mp_limb_t borrow = 0;
+        FIXINT_UNROLL
+        for(int i=0; i<N; i++) {
+            mp_limb_t x = in[i];
+            out[i]      = mp_limb_t(0) - x - borrow;
+            borrow      = (x != 0 || borrow != 0);
+        }
+        return;
+    }
+#endif
+    mpn_neg(out, in, N);
+}
+
+// out gets Nlhs + Nrhs limbs, and must not overlap the input
+template<int Nlhs, int Nrhs>
+inline void limbMul(mp_limb_t *out,
+                    const mp_limb_t *lhs, const mp_limb_t *rhs)
+{
+#if FIXINT_INLINE_LIMBS > 0
+    if(Nlhs + Nrhs <= 2*FIXINT_INLINE_LIMBS) {
+        for(int k=0; k<Nrhs; k++)
+            out[k] = 0;
+        FIXINT_UNROLL
+        for(int i=0; i<Nlhs; i++) {
+            DoubleLimb acc = 0;
+            FIXINT_UNROLL
+            for(int j=0; j<Nrhs; j++) {
+                acc       += DoubleLimb(lhs[i]) * rhs[j] + out[i+j];
+                out[i+j]   = mp_limb_t(acc);
+                acc      >>= LIMB_BIT_SIZE;
+            }
+            out[i+Nrhs] = mp_limb_t(acc);
+        }
+        return;
+    }
+#endif
+    if(Nlhs == Nrhs)
+        mpn_mul_n(out, lhs, rhs, Nlhs);
+    else if(Nlhs > Nrhs)
+        mpn_mul(out, lhs, Nlhs, rhs, Nrhs);
+    else // need to flip in order to satisfy calling condition...
+        mpn_mul(out, rhs, Nrhs, lhs, Nlhs);
+}
+
+template<int N>
+inline mp_limb_t limbSubmul1(mp_limb_t *out, const mp_limb_t *in,
+                             mp_limb_t scale)
+{
+#if FIXINT_INLINE_LIMBS > 0
+    if(N <= FIXINT_INLINE_LIMBS) {
+        mp_limb_t borrow = 0;
+        FIXINT_UNROLL
+        for(int i=0; i<N; i++) {
+            DoubleLimb prod = DoubleLimb(in[i]) * scale + borrow;
+            mp_limb_t  lo   = mp_limb_t(prod);
+            mp_limb_t  x    = out[i];
+            out[i]          = x - lo;
+            borrow          = mp_limb_t(prod >> LIMB_BIT_SIZE) + (x < lo);
+        }
+        return borrow;
+    }
+#endif
+    return mpn_submul_1(out, in, N, scale);
+}
+
 template<int Nlimbs>
 class LimbInt {
 public:
@@ -116,7 +282,7 @@ inline void promote(LimbInt<Nout> &out, const LimbInt<Nin> &in)
 {
     ASSERT_STATIC<(Nout >= Nin)>::test();
     
-    mpn_copyi(out.limbs, in.limbs, Nin);
+    limbCopyi<Nin>(out.limbs, in.limbs);
     
     if(Nout > Nin) { // fill out the higher order bits...
         mp_limb_t fill = SIGN_LIMB(out.limbs, Nin);
@@ -137,20 +303,20 @@ inline void add(LimbInt<Nout> &out,
     mp_limb_t carry;
     
     if(Nlhs == Nrhs) {
-        carry = mpn_add_n(out.limbs, lhs.limbs, rhs.limbs, Nlhs);
+        carry = limbAddN<Nlhs>(out.limbs, lhs.limbs, rhs.limbs);
     } else if(Nlhs > Nrhs) {
         mp_limb_t rhs_is_neg = SIGN_BOOL(rhs.limbs, Nrhs);
-        carry = mpn_add(out.limbs, lhs.limbs, Nlhs, rhs.limbs, Nrhs);
-        mp_limb_t borrow = mpn_sub_1(out.limbs+Nrhs,
-                                     out.limbs+Nrhs, Nlhs-Nrhs,
-                                     rhs_is_neg);
+        carry = limbAdd<Nlhs,Nrhs>(out.limbs, lhs.limbs, rhs.limbs);
+        mp_limb_t borrow = limbSub1<Nlhs-Nrhs>(out.limbs+Nrhs,
+                                               out.limbs+Nrhs,
+                                               rhs_is_neg);
         if(Nout > Nmax) carry = carry | (mp_limb_t(1) - borrow);
     } else { // Nrhs > Nlhs
         mp_limb_t lhs_is_neg = SIGN_BOOL(lhs.limbs, Nlhs);
-        carry = mpn_add(out.limbs, rhs.limbs, Nrhs, lhs.limbs, Nlhs);
-        mp_limb_t borrow = mpn_sub_1(out.limbs+Nlhs,
-                                     out.limbs+Nlhs, Nrhs-Nlhs,
-                                     lhs_is_neg);
+        carry = limbAdd<Nrhs,Nlhs>(out.limbs, rhs.limbs, lhs.limbs);
+        mp_limb_t borrow = limbSub1<Nrhs-Nlhs>(out.limbs+Nlhs,
+                                               out.limbs+Nlhs,
+                                               lhs_is_neg);
         if(Nout > Nmax) carry = carry | (mp_limb_t(1) - borrow);
     }
     
@@ -172,7 +338,7 @@ inline void sub(LimbInt<Nout> &out,
 {
     // for testing...
     LimbInt<Nrhs> tempright;
-    mpn_neg(tempright.limbs, rhs.limbs, Nrhs);
+    limbNeg<Nrhs>(tempright.limbs, rhs.limbs);
     add(out, lhs, tempright);
     /*ASSERT_STATIC<(Nout >= Nlhs && Nout >= Nrhs)>::test();
     const mp_limb_t *left   = lhs.limbs;
@@ -241,7 +407,7 @@ inline void neg(LimbInt<Nout> &out,
 {
     ASSERT_STATIC<(Nout >= Nin)>::test();
     
-    mpn_neg(out.limbs, in.limbs, Nin);
+    limbNeg<Nin>(out.limbs, in.limbs);
     
     if(Nout > Nin) {
         mp_limb_t fill = SIGN_LIMB(out.limbs, Nin);
@@ -264,22 +430,17 @@ inline void mul(LimbInt<Nout> &out,
         res = tempresult.limbs;
     
     // multiply
-    if(Nlhs == Nrhs)
-        mpn_mul_n(res, lhs.limbs, rhs.limbs, Nlhs);
-    else if(Nlhs > Nrhs)
-        mpn_mul(res, lhs.limbs, Nlhs, rhs.limbs, Nrhs);
-    else // need to flip in order to satisfy calling condition...
-        mpn_mul(res, rhs.limbs, Nrhs, lhs.limbs, Nlhs);
+    limbMul<Nlhs,Nrhs>(res, lhs.limbs, rhs.limbs);
     
     mp_limb_t lhs_sign = SIGN_BOOL(lhs.limbs,Nlhs);
     mp_limb_t rhs_sign = SIGN_BOOL(rhs.limbs,Nrhs);
     
-    mpn_submul_1((res+Nlhs), rhs.limbs, Nrhs, lhs_sign);
-    mpn_submul_1((res+Nrhs), lhs.limbs, Nlhs, rhs_sign);
+    limbSubmul1<Nrhs>((res+Nlhs), rhs.limbs, lhs_sign);
+    limbSubmul1<Nlhs>((res+Nrhs), lhs.limbs, rhs_sign);
     
     // transfer large result if we had one...
     if(Nout < Nlhs + Nrhs)
-        mpn_copyi(out.limbs, res, Nout);
+        limbCopyi<Nout>(out.limbs, res);
     
     // if we have more limbs than needed for the multiply,
     // fill out the extra higher order limbs...
@@ -302,30 +463,39 @@ int sign(const LimbInt<N> &in)
     return SIGN_INT(in.limbs,N) * int(nonzero);
 }
 
-//template<int N>
-//inline
-//double approximate(const LimbInt<N> &in)
-//{
-//    std::cout << in << std::endl;
-//    // not the most efficient implementation, but it should work
-//    LimbInt<N>  tmp;
-//    double      sign;
-//    if(SIGN_BOOL(in.limbs, N-1)) {
-//        neg(tmp, in);
-//        sign = -1.0;
-//    } else {
-//        tmp = in;
-//        sign = 1.0;
-//    }
-//    std::cout << tmp << std::endl;
-//    std::cout << typeid(mp_limb_t).name() << std::endl;
-//    std::cout << double(in.limbs[2]) << std::endl;
-//    double result = 0.0;
-//    for(int i=0; i<N; i++) {
-//        result += ldexp(double(in.limbs[i]), i * LIMB_BIT_SIZE);
-//    }
-//    return sign * result;
-//}
+// Nearest double towards zero (i.e. the same as mpz_get_d)
+template<int N>
+inline
+double approximate(const LimbInt<N> &in)
+{
+    LimbInt<N>  mag;
+    bool        neg = SIGN_BOOL(in.limbs,N);
+    if(neg)
+        limbNeg<N>(mag.limbs, in.limbs);
+    else
+        mag = in;
+    
+    // find the most significant bit
+    int top = N-1;
+    while(top > 0 && mag.limbs[top] == 0)
+        top--;
+    if(mag.limbs[top] == 0)
+        return 0.0;
+    int msb = top*LIMB_BIT_SIZE;
+    for(mp_limb_t bits = mag.limbs[top] >> 1; bits != 0; bits >>= 1)
+        msb++;
+    
+    // and keep the 53 bits from there on down, dropping the rest
+    int low = (msb > 52)? msb - 52 : 0;
+    unsigned long long mantissa = 0;
+    for(int b=msb; b>=low; b--) {
+        mp_limb_t bit = (mag.limbs[b / LIMB_BIT_SIZE] >>
+                         (b % LIMB_BIT_SIZE)) & 1;
+        mantissa = (mantissa << 1) | bit;
+    }
+    double result = ldexp(double(mantissa), low);
+    return (neg)? -result : result;
+}
 
 template<int N>
 inline
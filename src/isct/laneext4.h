@@ -0,0 +1,323 @@
+// +-------------------------------------------------------------------------
+// | laneext4.h
+// | 
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+#pragma once
+
+/*
+ *
+ *  LaneExt4
+ *
+ *      The Ext4 and AbsExt4 algebras, evaluated on several
+ *      independent inputs at once.
+ *
+ *      Each number is a "lane" type L, which is either a plain double
+ *      or a vector of doubles (see Lanes<L> below).  The operations are
+ *      carried out in exactly the same order as in ext4.h/absext4.h,
+ *      so every lane rounds the same way the scalar code would, as
+ *      long as neither gets fused multiply-adds (-ffp-contract=off).
+ *
+ */
+
+#include <cstring>
+ 
+namespace LaneExt4 {
+
+// Lanes<L> describes a lane type:
+//      WIDTH       number of doubles in it
+//      Mask        result type of comparisons
+//      splat(x)    all lanes set to x
+//      load(p)     lanes from p[0], ..., p[WIDTH-1]
+//      lane(m, k)  whether lane k of a mask is set
+// Masks combine with & and |, and select with m? a : b
+template<class L>
+struct Lanes;
+
+template<>
+struct Lanes<double>
+{
+    static const unsigned int WIDTH = 1;
+    typedef bool Mask;
+    static inline double splat(double x)            { return x; }
+    static inline double load(const double *p)      { return *p; }
+    static inline bool   lane(bool m, unsigned int) { return m; }
+};
+
+// GCC/Clang vector extensions; the arithmetic is compiled for
+// whatever instruction set the function using it targets
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CORK_VECTOR_LANES
+// (these only ever get inlined into functions compiled for AVX/AVX-512,
+//  so the warnings about passing vectors to other code don't apply;
+//  they're off until the end of this file)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef double      LaneD4 __attribute__((vector_size(32)));
+typedef long long   MaskD4 __attribute__((vector_size(32)));
+typedef double      LaneD8 __attribute__((vector_size(64)));
+typedef long long   MaskD8 __attribute__((vector_size(64)));
+
+template<>
+struct Lanes<LaneD4>
+{
+    static const unsigned int WIDTH = 4;
+    typedef MaskD4 Mask;
+    static inline LaneD4 splat(double x) {
+        LaneD4 out = { x, x, x, x };
+        return out;
+    }
+    static inline LaneD4 load(const double *p) {
+        LaneD4 out;
+        std::memcpy(&out, p, sizeof(out));
+        return out;
+    }
+    static inline bool lane(const MaskD4 &m, unsigned int k) {
+        return m[k] != 0;
+    }
+};
+
+template<>
+struct Lanes<LaneD8>
+{
+    static const unsigned int WIDTH = 8;
+    typedef MaskD8 Mask;
+    static inline LaneD8 splat(double x) {
+        LaneD8 out = { x, x, x, x, x, x, x, x };
+        return out;
+    }
+    static inline LaneD8 load(const double *p) {
+        LaneD8 out;
+        std::memcpy(&out, p, sizeof(out));
+        return out;
+    }
+    static inline bool lane(const MaskD8 &m, unsigned int k) {
+        return m[k] != 0;
+    }
+};
+#endif
+
+template<class L>
+inline L fabs(const L &x) {
+    return (x < Lanes<L>::splat(0.0))? -x : x;
+}
+
+
+// ************************
+// k-vectors (as in ext4.h)
+
+template<class L>
+struct LaneExt4_1 {
+    L e0, e1, e2, e3;
+};
+template<class L>
+struct LaneExt4_2 {
+    L e01, e02, e03, e12, e13, e23;
+};
+template<class L>
+struct LaneExt4_3 {
+    L e012, e013, e023, e123;
+};
+
+template<class L>
+inline void dual(LaneExt4_2<L> &out, const LaneExt4_2<L> &in) {
+    out.e01 =  in.e23;
+    out.e02 = -in.e13;
+    out.e03 =  in.e12;
+    out.e12 =  in.e03;
+    out.e13 = -in.e02;
+    out.e23 =  in.e01;
+}
+template<class L>
+inline void dual(LaneExt4_1<L> &out, const LaneExt4_3<L> &in) {
+    out.e0 =  in.e123;
+    out.e1 = -in.e023;
+    out.e2 =  in.e013;
+    out.e3 = -in.e012;
+}
+template<class L>
+inline void revdual(LaneExt4_1<L> &out, const LaneExt4_3<L> &in) {
+    out.e0 = -in.e123;
+    out.e1 =  in.e023;
+    out.e2 = -in.e013;
+    out.e3 =  in.e012;
+}
+
+template<class L>
+inline void join(LaneExt4_2<L> &out,
+                 const LaneExt4_1<L> &lhs, const LaneExt4_1<L> &rhs) {
+    out.e01 = (lhs.e0 * rhs.e1) - (rhs.e0 * lhs.e1);
+    out.e02 = (lhs.e0 * rhs.e2) - (rhs.e0 * lhs.e2);
+    out.e03 = (lhs.e0 * rhs.e3) - (rhs.e0 * lhs.e3);
+    out.e12 = (lhs.e1 * rhs.e2) - (rhs.e1 * lhs.e2);
+    out.e13 = (lhs.e1 * rhs.e3) - (rhs.e1 * lhs.e3);
+    out.e23 = (lhs.e2 * rhs.e3) - (rhs.e2 * lhs.e3);
+}
+template<class L>
+inline void join(LaneExt4_3<L> &out,
+                 const LaneExt4_2<L> &lhs, const LaneExt4_1<L> &rhs) {
+    out.e012 = (lhs.e01 * rhs.e2) - (lhs.e02 * rhs.e1) + (lhs.e12 *rhs.e0);
+    out.e013 = (lhs.e01 * rhs.e3) - (lhs.e03 * rhs.e1) + (lhs.e13 *rhs.e0);
+    out.e023 = (lhs.e02 * rhs.e3) - (lhs.e03 * rhs.e2) + (lhs.e23 *rhs.e0);
+    out.e123 = (lhs.e12 * rhs.e3) - (lhs.e13 * rhs.e2) + (lhs.e23 *rhs.e1);
+}
+
+template<class L>
+inline void meet(LaneExt4_1<L> &out,
+                 const LaneExt4_2<L> &lhs, const LaneExt4_3<L> &rhs) {
+    LaneExt4_3<L> out_dual;
+    LaneExt4_2<L> lhs_dual;
+    LaneExt4_1<L> rhs_dual;
+    dual(lhs_dual, lhs);
+    dual(rhs_dual, rhs);
+    join(out_dual, lhs_dual, rhs_dual);
+    revdual(out, out_dual);
+}
+
+template<class L>
+inline L inner(const LaneExt4_2<L> &lhs, const LaneExt4_2<L> &rhs) {
+    L acc = Lanes<L>::splat(0.0);
+    acc += lhs.e01 * rhs.e01;
+    acc += lhs.e02 * rhs.e02;
+    acc += lhs.e03 * rhs.e03;
+    acc += lhs.e12 * rhs.e12;
+    acc += lhs.e13 * rhs.e13;
+    acc += lhs.e23 * rhs.e23;
+    return acc;
+}
+template<class L>
+inline L inner(const LaneExt4_3<L> &lhs, const LaneExt4_3<L> &rhs) {
+    L acc = Lanes<L>::splat(0.0);
+    acc += lhs.e012 * rhs.e012;
+    acc += lhs.e013 * rhs.e013;
+    acc += lhs.e023 * rhs.e023;
+    acc += lhs.e123 * rhs.e123;
+    return acc;
+}
+
+
+// ************************
+// absolute value k-vectors (as in absext4.h)
+
+template<class L>
+struct LaneAbsExt4_1 {
+    L e0, e1, e2, e3;
+};
+template<class L>
+struct LaneAbsExt4_2 {
+    L e01, e02, e03, e12, e13, e23;
+};
+template<class L>
+struct LaneAbsExt4_3 {
+    L e012, e013, e023, e123;
+};
+
+template<class L>
+inline void abs(LaneAbsExt4_1<L> &out, const LaneExt4_1<L> &in) {
+    out.e0 = fabs(in.e0);
+    out.e1 = fabs(in.e1);
+    out.e2 = fabs(in.e2);
+    out.e3 = fabs(in.e3);
+}
+
+template<class L>
+inline void dual(LaneAbsExt4_2<L> &out, const LaneAbsExt4_2<L> &in) {
+    out.e01 = in.e23;
+    out.e02 = in.e13;
+    out.e03 = in.e12;
+    out.e12 = in.e03;
+    out.e13 = in.e02;
+    out.e23 = in.e01;
+}
+template<class L>
+inline void dual(LaneAbsExt4_1<L> &out, const LaneAbsExt4_3<L> &in) {
+    out.e0 = in.e123;
+    out.e1 = in.e023;
+    out.e2 = in.e013;
+    out.e3 = in.e012;
+}
+template<class L>
+inline void revdual(LaneAbsExt4_1<L> &out, const LaneAbsExt4_3<L> &in) {
+    out.e0 = in.e123;
+    out.e1 = in.e023;
+    out.e2 = in.e013;
+    out.e3 = in.e012;
+}
+
+template<class L>
+inline void join(LaneAbsExt4_2<L> &out,
+                 const LaneAbsExt4_1<L> &lhs, const LaneAbsExt4_1<L> &rhs) {
+    out.e01 = (lhs.e0 * rhs.e1) + (rhs.e0 * lhs.e1);
+    out.e02 = (lhs.e0 * rhs.e2) + (rhs.e0 * lhs.e2);
+    out.e03 = (lhs.e0 * rhs.e3) + (rhs.e0 * lhs.e3);
+    out.e12 = (lhs.e1 * rhs.e2) + (rhs.e1 * lhs.e2);
+    out.e13 = (lhs.e1 * rhs.e3) + (rhs.e1 * lhs.e3);
+    out.e23 = (lhs.e2 * rhs.e3) + (rhs.e2 * lhs.e3);
+}
+template<class L>
+inline void join(LaneAbsExt4_3<L> &out,
+                 const LaneAbsExt4_2<L> &lhs, const LaneAbsExt4_1<L> &rhs) {
+    out.e012 = (lhs.e01 * rhs.e2) + (lhs.e02 * rhs.e1) + (lhs.e12 *rhs.e0);
+    out.e013 = (lhs.e01 * rhs.e3) + (lhs.e03 * rhs.e1) + (lhs.e13 *rhs.e0);
+    out.e023 = (lhs.e02 * rhs.e3) + (lhs.e03 * rhs.e2) + (lhs.e23 *rhs.e0);
+    out.e123 = (lhs.e12 * rhs.e3) + (lhs.e13 * rhs.e2) + (lhs.e23 *rhs.e1);
+}
+
+template<class L>
+inline void meet(LaneAbsExt4_1<L> &out,
+                 const LaneAbsExt4_2<L> &lhs, const LaneAbsExt4_3<L> &rhs) {
+    LaneAbsExt4_3<L> out_dual;
+    LaneAbsExt4_2<L> lhs_dual;
+    LaneAbsExt4_1<L> rhs_dual;
+    dual(lhs_dual, lhs);
+    dual(rhs_dual, rhs);
+    join(out_dual, lhs_dual, rhs_dual);
+    revdual(out, out_dual);
+}
+
+template<class L>
+inline L inner(const LaneAbsExt4_2<L> &lhs, const LaneAbsExt4_2<L> &rhs) {
+    L acc = Lanes<L>::splat(0.0);
+    acc += lhs.e01 * rhs.e01;
+    acc += lhs.e02 * rhs.e02;
+    acc += lhs.e03 * rhs.e03;
+    acc += lhs.e12 * rhs.e12;
+    acc += lhs.e13 * rhs.e13;
+    acc += lhs.e23 * rhs.e23;
+    return acc;
+}
+template<class L>
+inline L inner(const LaneAbsExt4_3<L> &lhs, const LaneAbsExt4_3<L> &rhs) {
+    L acc = Lanes<L>::splat(0.0);
+    acc += lhs.e012 * rhs.e012;
+    acc += lhs.e013 * rhs.e013;
+    acc += lhs.e023 * rhs.e023;
+    acc += lhs.e123 * rhs.e123;
+    return acc;
+}
+
+
+} // end namespace LaneExt4
+
+#ifdef CORK_VECTOR_LANES
+#pragma GCC diagnostic pop
+#endif
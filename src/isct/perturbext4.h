@@ -0,0 +1,363 @@
+// +-------------------------------------------------------------------------
+// | perturbext4.h
+// | 
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+#pragma once
+
+#ifdef _WIN32
+#pragma warning(disable: 4800)
+#pragma warning(disable: 4244)
+#include <mpirxx.h>
+#pragma warning(default: 4244)
+#pragma warning(default: 4800)
+#else
+#include <gmpxx.h>
+#endif
+
+#include "prelude.h"
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+
+
+// Exact arithmetic on points which have been moved by an infinitesimal
+// amount (Simulation of Simplicity, after Edelsbrunner and Muecke).
+// Each coordinate of each vertex gets its own infinitesimal eps_k, with
+// k = 3*id + axis, so every quantity is a polynomial in them.  Its sign
+// is the sign of its dominant term, where a product of fewer eps
+// dominates one of more, and between products of as many, the first
+// eps whose powers differ decides (the lower power wins).
+//  That order is kept by multiplication, so truncating everything to
+// products of at most max_degree eps still gives all the terms of that
+// degree exactly; if those are all zero, try again with a larger degree.
+// The sign is only zero for every degree if the polynomial is
+// identically zero, which no perturbation can fix.
+namespace PerturbExt4 {
+
+// a product of infinitesimals as (k, power) pairs, sorted by k
+typedef std::vector< std::pair<unsigned long long, uint> > EpsMonomial;
+
+inline uint degree(const EpsMonomial &m)
+{
+    uint d = 0;
+    for(const auto &factor : m)
+        d += factor.second;
+    return d;
+}
+
+// does a dominate b (i.e. is b infinitely smaller)?
+struct Dominates {
+    bool operator()(const EpsMonomial &a, const EpsMonomial &b) const {
+        uint da = degree(a);
+        uint db = degree(b);
+        if(da != db)
+            return da < db;
+        uint i = 0, j = 0;
+        while(i < a.size() || j < b.size()) {
+            uint pa = 0, pb = 0;
+            if(j == b.size() ||
+               (i < a.size() && a[i].first < b[j].first)) {
+                pa = a[i++].second;
+            } else if(i == a.size() || b[j].first < a[i].first) {
+                pb = b[j++].second;
+            } else {
+                pa = a[i++].second;
+                pb = b[j++].second;
+            }
+            if(pa != pb)
+                return pa < pb;
+        }
+        return false;
+    }
+};
+
+// sum of coeff * monomial, dominant term first, dropping every
+// term of degree above max_degree.  Zero coefficients are never stored
+struct EpsPoly {
+    typedef std::map<EpsMonomial, mpz_class, Dominates> Terms;
+    Terms terms;
+    uint  max_degree;
+    
+    EpsPoly() : max_degree(~0u) {}
+    EpsPoly(const mpz_class &c0) : max_degree(~0u) {
+        if(sgn(c0) != 0)
+            terms[EpsMonomial()] = c0;
+    }
+    // c0 + eps_k
+    EpsPoly(const mpz_class &c0, unsigned long long k, uint max_deg)
+    : EpsPoly(c0) {
+        max_degree = max_deg;
+        if(max_degree > 0)
+            terms[EpsMonomial(1, std::make_pair(k, 1u))] = 1;
+    }
+    
+    void add(const EpsMonomial &m, const mpz_class &coeff) {
+        auto it = terms.find(m);
+        if(it == terms.end()) {
+            terms.insert(std::make_pair(m, coeff));
+        } else {
+            it->second += coeff;
+            if(sgn(it->second) == 0)
+                terms.erase(it);
+        }
+    }
+};
+
+inline EpsMonomial operator*(const EpsMonomial &lhs, const EpsMonomial &rhs)
+{
+    EpsMonomial out;
+    out.reserve(lhs.size() + rhs.size());
+    uint i = 0, j = 0;
+    while(i < lhs.size() || j < rhs.size()) {
+        if(j == rhs.size() ||
+           (i < lhs.size() && lhs[i].first < rhs[j].first)) {
+            out.push_back(lhs[i++]);
+        } else if(i == lhs.size() || rhs[j].first < lhs[i].first) {
+            out.push_back(rhs[j++]);
+        } else {
+            out.push_back(std::make_pair(lhs[i].first,
+                                         lhs[i].second + rhs[j].second));
+            i++;    j++;
+        }
+    }
+    return out;
+}
+
+inline EpsPoly operator-(const EpsPoly &in)
+{
+    EpsPoly out = in;
+    for(auto &term : out.terms)
+        term.second = -term.second;
+    return out;
+}
+inline EpsPoly operator+(const EpsPoly &lhs, const EpsPoly &rhs)
+{
+    EpsPoly out = lhs;
+    out.max_degree = std::min(lhs.max_degree, rhs.max_degree);
+    for(const auto &term : rhs.terms)
+        out.add(term.first, term.second);
+    return out;
+}
+inline EpsPoly operator-(const EpsPoly &lhs, const EpsPoly &rhs)
+{
+    EpsPoly out = lhs;
+    out.max_degree = std::min(lhs.max_degree, rhs.max_degree);
+    for(const auto &term : rhs.terms)
+        out.add(term.first, -term.second);
+    return out;
+}
+inline EpsPoly operator*(const EpsPoly &lhs, const EpsPoly &rhs)
+{
+    EpsPoly out;
+    out.max_degree = std::min(lhs.max_degree, rhs.max_degree);
+    for(const auto &l : lhs.terms) {
+        uint dl = degree(l.first);
+        if(dl > out.max_degree)     break;
+        for(const auto &r : rhs.terms) {
+            // the terms come in order of degree
+            if(dl + degree(r.first) > out.max_degree)   break;
+            out.add(l.first * r.first, l.second * r.second);
+        }
+    }
+    return out;
+}
+
+// the sign of the dominant term; zero if there is no term
+// (up to max_degree)
+inline int sign(const EpsPoly &p)
+{
+    return (p.terms.empty())? 0 : sgn(p.terms.begin()->second);
+}
+
+// the coefficient of the given monomial (zero if there is no such term)
+inline mpz_class coeff(const EpsPoly &p, const EpsMonomial &m)
+{
+    auto it = p.terms.find(m);
+    return (it == p.terms.end())? mpz_class(0) : it->second;
+}
+
+// types for k-vectors in R4:
+//      Ext4_k
+
+struct PerturbExt4_1 {
+    EpsPoly e0;
+    EpsPoly e1;
+    EpsPoly e2;
+    EpsPoly e3;
+};
+
+struct PerturbExt4_2 {
+    EpsPoly e01;
+    EpsPoly e02;
+    EpsPoly e03;
+    EpsPoly e12;
+    EpsPoly e13;
+    EpsPoly e23;
+};
+
+struct PerturbExt4_3 {
+    EpsPoly e012;
+    EpsPoly e013;
+    EpsPoly e023;
+    EpsPoly e123;
+};
+
+
+// ********************************
+// A neg takes a k-vector and returns its negation
+// neg(X,Y) is safe for X=Y
+inline
+void neg(PerturbExt4_1 &out, const PerturbExt4_1 &in)
+{
+    out.e0 = -in.e0;
+    out.e1 = -in.e1;
+    out.e2 = -in.e2;
+    out.e3 = -in.e3;
+}
+
+
+// ********************************
+// A dual operation takes a k-vector and returns a (4-k)-vector
+// A reverse dual operation inverts the dual operation
+// dual(X,Y) is not safe for X=Y (same with revdual)
+inline
+void dual(PerturbExt4_1 &out, const PerturbExt4_3 &in)
+{
+    out.e0 =  in.e123;
+    out.e1 = -in.e023;
+    out.e2 =  in.e013;
+    out.e3 = -in.e012;
+}
+inline
+void dual(PerturbExt4_2 &out, const PerturbExt4_2 &in)
+{
+    out.e01 =  in.e23;
+    out.e02 = -in.e13;
+    out.e03 =  in.e12;
+    out.e12 =  in.e03;
+    out.e13 = -in.e02;
+    out.e23 =  in.e01;
+}
+inline
+void revdual(PerturbExt4_1 &out, const PerturbExt4_3 &in)
+{
+    out.e0 = -in.e123;
+    out.e1 =  in.e023;
+    out.e2 = -in.e013;
+    out.e3 =  in.e012;
+}
+inline
+void revdual(PerturbExt4_2 &out, const PerturbExt4_2 &in)
+{
+    out.e01 =  in.e23;
+    out.e02 = -in.e13;
+    out.e03 =  in.e12;
+    out.e12 =  in.e03;
+    out.e13 = -in.e02;
+    out.e23 =  in.e01;
+}
+
+
+// ********************************
+// A join takes a j-vector and a k-vector and returns a (j+k)-vector
+inline
+void join(PerturbExt4_2 &out, const PerturbExt4_1 &lhs, const PerturbExt4_1 &rhs)
+{
+    out.e01 = (lhs.e0 * rhs.e1) - (rhs.e0 * lhs.e1);
+    out.e02 = (lhs.e0 * rhs.e2) - (rhs.e0 * lhs.e2);
+    out.e03 = (lhs.e0 * rhs.e3) - (rhs.e0 * lhs.e3);
+    out.e12 = (lhs.e1 * rhs.e2) - (rhs.e1 * lhs.e2);
+    out.e13 = (lhs.e1 * rhs.e3) - (rhs.e1 * lhs.e3);
+    out.e23 = (lhs.e2 * rhs.e3) - (rhs.e2 * lhs.e3);
+}
+inline
+void join(PerturbExt4_3 &out, const PerturbExt4_2 &lhs, const PerturbExt4_1 &rhs)
+{
+    out.e012 = (lhs.e01 * rhs.e2) - (lhs.e02 * rhs.e1) + (lhs.e12 *rhs.e0);
+    out.e013 = (lhs.e01 * rhs.e3) - (lhs.e03 * rhs.e1) + (lhs.e13 *rhs.e0);
+    out.e023 = (lhs.e02 * rhs.e3) - (lhs.e03 * rhs.e2) + (lhs.e23 *rhs.e0);
+    out.e123 = (lhs.e12 * rhs.e3) - (lhs.e13 * rhs.e2) + (lhs.e23 *rhs.e1);
+}
+inline
+void join(PerturbExt4_3 &out, const PerturbExt4_1 &lhs, const PerturbExt4_2 &rhs)
+{
+    join(out, rhs, lhs);
+    // no negation since swapping the arguments requires two
+    // swaps of 1-vectors
+}
+
+
+// ********************************
+// A meet takes a j-vector and a k-vector and returns a (j+k-4)-vector
+inline
+void meet(PerturbExt4_2 &out, const PerturbExt4_3 &lhs, const PerturbExt4_3 &rhs)
+{
+    PerturbExt4_2 out_dual;
+    PerturbExt4_1 lhs_dual;
+    PerturbExt4_1 rhs_dual;
+    dual(lhs_dual, lhs);
+    dual(rhs_dual, rhs);
+    join(out_dual, lhs_dual, rhs_dual);
+    revdual(out, out_dual);
+}
+inline
+void meet(PerturbExt4_1 &out, const PerturbExt4_2 &lhs, const PerturbExt4_3 &rhs)
+{
+    PerturbExt4_3 out_dual;
+    PerturbExt4_2 lhs_dual;
+    PerturbExt4_1 rhs_dual;
+    dual(lhs_dual, lhs);
+    dual(rhs_dual, rhs);
+    join(out_dual, lhs_dual, rhs_dual);
+    revdual(out, out_dual);
+}
+
+
+// ********************************
+// An inner product takes two k-vectors and produces a single number
+inline
+EpsPoly inner(const PerturbExt4_2 &lhs, const PerturbExt4_2 &rhs)
+{
+    return lhs.e01 * rhs.e01 +
+           lhs.e02 * rhs.e02 +
+           lhs.e03 * rhs.e03 +
+           lhs.e12 * rhs.e12 +
+           lhs.e13 * rhs.e13 +
+           lhs.e23 * rhs.e23;
+}
+inline
+EpsPoly inner(const PerturbExt4_3 &lhs, const PerturbExt4_3 &rhs)
+{
+    return lhs.e012 * rhs.e012 +
+           lhs.e013 * rhs.e013 +
+           lhs.e023 * rhs.e023 +
+           lhs.e123 * rhs.e123;
+}
+
+
+
+
+
+
+} // end namespace PerturbExt4
@@ -27,8 +27,17 @@
 
 namespace Quantization {
 
-double MAGNIFY = 1.0;
-double RESHRINK = 1.0;
+void Quantizer::callibrate(double maximumMagnitude)
+{
+    int max_exponent;
+    std::frexp(maximumMagnitude, &max_exponent);
+    max_exponent++; // ensure that 2^max_exponent > maximumMagnitude
+    
+    // set constants
+    MAGNIFY = std::pow(2.0, BITS - max_exponent);
+    // we are guaranteed that maximumMagnitude * MAGNIFY < 2.0^BITS
+    RESHRINK = std::pow(2.0, max_exponent - BITS);
+}
 
 } // end namespace Quantization
 
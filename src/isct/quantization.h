@@ -29,37 +29,36 @@
 
 namespace Quantization {
 
-// NOTE: none of these values should be modified by the clients
 static const int BITS = 30;
-// MAGNIFY * RESHRINK == 1
-extern double MAGNIFY;
-extern double RESHRINK;
-inline int quantize2int(double number) {
-    return int(number * MAGNIFY);
-}
-inline double quantizedInt2double(int number) {
-    return RESHRINK * double(number);
-}
-inline double quantize(double number) {
-    return RESHRINK * double(int(number * MAGNIFY));
-}
 
-// given the specified number of bits,
-// and bound on the coordinate values of points,
-// fit as fine-grained a grid as possible over the space.
-inline void callibrate(double maximumMagnitude)
+// A Quantizer carries the grid that coordinates are snapped to.
+// It is kept per-computation, rather than globally, so that
+// independent computations can use different grids concurrently.
+struct Quantizer
 {
-    int max_exponent;
-    std::frexp(maximumMagnitude, &max_exponent);
-    max_exponent++; // ensure that 2^max_exponent > maximumMagnitude
+    // NOTE: these values should only be set by callibrate()
+    // MAGNIFY * RESHRINK == 1
+    double MAGNIFY;
+    double RESHRINK;
     
-    // set constants
-    MAGNIFY = std::pow(2.0, BITS - max_exponent);
-    // we are guaranteed that maximumMagnitude * MAGNIFY < 2.0^BITS
-    RESHRINK = std::pow(2.0, max_exponent - BITS);
-}
+    Quantizer() : MAGNIFY(1.0), RESHRINK(1.0) {}
+    
+    inline int quantize2int(double number) const {
+        return int(number * MAGNIFY);
+    }
+    inline double quantizedInt2double(int number) const {
+        return RESHRINK * double(number);
+    }
+    inline double quantize(double number) const {
+        return RESHRINK * double(int(number * MAGNIFY));
+    }
+    
+    // given the specified number of bits,
+    // and bound on the coordinate values of points,
+    // fit as fine-grained a grid as possible over the space.
+    void callibrate(double maximumMagnitude);
+};
 
 
 } // end namespace Quantization
 
-
@@ -300,15 +300,70 @@ void CmdList::runCommands(std::vector<string>::iterator &arg_it,
 }
 
 
+typedef std::function< void(const std::vector<CorkTriMesh> &in,
+                             CorkTriMesh *out) > NaryOp;
+
+// ((in0 OP in1) OP in2) ... OP inN,
+// computed in a single pass rather than one operation at a time
+NaryOp chainCSG(CorkCSGOp op)
+{
+    return [op](const std::vector<CorkTriMesh> &in, CorkTriMesh *out) {
+        std::vector<CorkCSGNode> nodes(in.size());
+        for(uint i=0; i<in.size(); i++) {
+            nodes[i].op         = CORK_CSG_OPERAND;
+            nodes[i].operand    = i;
+        }
+        uint prev = 0;
+        for(uint i=1; i<in.size(); i++) {
+            CorkCSGNode node;
+            node.op     = op;
+            node.left   = prev;
+            node.right  = i;
+            prev = nodes.size();
+            nodes.push_back(node);
+        }
+        computeCSG(in.size(), in.data(), nodes.size(), nodes.data(), out);
+    };
+}
+
+// resolving intersections treats both inputs as one mesh anyway,
+// so all but the last input can just be glued together
+void resolveAll(const std::vector<CorkTriMesh> &in, CorkTriMesh *out)
+{
+    CorkTriMesh head;
+    head.n_vertices = head.n_triangles = 0;
+    for(uint i=0; i+1<in.size(); i++) {
+        head.n_vertices  += in[i].n_vertices;
+        head.n_triangles += in[i].n_triangles;
+    }
+    head.triangles = new uint[head.n_triangles * 3];
+    head.vertices  = new float[head.n_vertices * 3];
+    
+    uint voffset = 0, toffset = 0;
+    for(uint i=0; i+1<in.size(); i++) {
+        for(uint k=0; k<in[i].n_triangles * 3; k++)
+            head.triangles[toffset*3 + k] = in[i].triangles[k] + voffset;
+        for(uint k=0; k<in[i].n_vertices * 3; k++)
+            head.vertices[voffset*3 + k] = in[i].vertices[k];
+        voffset += in[i].n_vertices;
+        toffset += in[i].n_triangles;
+    }
+    
+    resolveIntersections(head, in.back(), out);
+    
+    freeCorkTriMesh(&head);
+}
+
 std::function< void(
     std::vector<string>::iterator &,
     const std::vector<string>::iterator &
 ) >
 genericBinaryOp(
     std::function< void(CorkTriMesh in0, CorkTriMesh in1, CorkTriMesh *out) > binop,
+    NaryOp naryop,
     bool needsplit
 ) {
-    return [binop, needsplit]
+    return [binop, naryop, needsplit]
     (std::vector<string>::iterator &args,
      const std::vector<string>::iterator &end) {
         // data...
@@ -326,22 +381,7 @@ genericBinaryOp(
             binop(in.front(), in.back(), &out);
         }
         else {
-            CorkTriMesh *out = nullptr;
-            for(auto inval = in.begin()+1; inval != in.end(); ++inval) {
-                bool first = out == nullptr;
-                CorkTriMesh *tmp = !first ? out : &in.front();
-                out = new CorkTriMesh();
-                std::cerr << tmp->n_vertices << "/" << tmp->n_triangles << "  " << inval->n_vertices << "/" << inval->n_triangles << std::endl;
-                binop(*tmp, *inval, out);
-                if(!first) {
-                    freeCorkTriMesh(tmp);
-                    delete tmp;
-                }
-            }
-            if(out){
-                freeCorkTriMesh(out);
-                delete out;
-            }
+            naryop(in, &out);
         }
         
         if(args == end) { cerr << "too few args" << endl; exit(1); }
@@ -415,29 +455,29 @@ int main(int argc, char *argv[])
     "-union in0 ... inN [-split] out     Compute the Boolean union of in0 and in1,\n"
     "                                    and output the result\n"
     "                                    split - optional for 2 and more obj in file",
-    genericBinaryOp(computeUnion, needsplit));
+    genericBinaryOp(computeUnion, chainCSG(CORK_CSG_UNION), needsplit));
     cmds.regCmd("diff",
     "-diff in0 ... inN [-split] out      Compute the Boolean difference of in0 and in1,\n"
     "                                    and output the result\n"
     "                                    split - optional for 2 and more obj in file",
-    genericBinaryOp(computeDifference, needsplit));
+    genericBinaryOp(computeDifference, chainCSG(CORK_CSG_DIFFERENCE), needsplit));
     cmds.regCmd("isct",
     "-isct in0 ... inN [-split] out      Compute the Boolean intersection of in0 and in1,\n"
     "                                    and output the result\n"
     "                                    split - optional for 2 and more obj in file",
-    genericBinaryOp(computeIntersection, needsplit));
+    genericBinaryOp(computeIntersection, chainCSG(CORK_CSG_INTERSECTION), needsplit));
     cmds.regCmd("xor",
     "-xor in0 ... inN [-split] out       Compute the Boolean XOR of in0 and in1,\n"
     "                                    and output the result\n"
     "                                    (aka. the symmetric difference)\n"
     "                                    split - optional for 2 and more obj in file",
-    genericBinaryOp(computeSymmetricDifference, needsplit));
+    genericBinaryOp(computeSymmetricDifference, chainCSG(CORK_CSG_SYMMETRIC_DIFFERENCE), needsplit));
     cmds.regCmd("resolve",
     "-resolve in0 ... inN [-split] out   Intersect the two meshes in0 and in1,\n"
     "                                    and output the connected mesh with those\n"
     "                                    intersections made explicit and connected\n"
     "                                    split - optional for 2 and more obj in file",
-    genericBinaryOp(resolveIntersections, needsplit));
+    genericBinaryOp(resolveIntersections, resolveAll, needsplit));
     
     
     cmds.runCommands(arg_it, args.end());
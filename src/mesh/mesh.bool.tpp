@@ -25,49 +25,106 @@
 // +-------------------------------------------------------------------------
 #pragma once
 
+#include "fastWinding.h"
+#include "parallel.h"
+
 #include <queue>
+#include <map>
+#include <mutex>
 
 template<class VertData, class TriData>
 class Mesh<VertData,TriData>::BoolProblem
 {
 public:
-    BoolProblem(Mesh *owner) : mesh(owner)
+    BoolProblem(Mesh *owner, CorkContext *context) :
+        mesh(owner), ctx(context), n_operands(0),
+        ray_seed(context->random.next())
     {}
-    virtual ~BoolProblem() {}
+    virtual ~BoolProblem() {
+        for(AABVH<uint> *bvh : tri_bvhs)
+            delete bvh;
+        for(FastWinding *fw : windings)
+            delete fw;
+    }
     
     // do things
-    void doSetup(Mesh &rhs);
+    void doSetup(const Mesh &rhs);
+    // or with any number of operands; the owner is operand 0
+    void doSetup(const std::vector<const Mesh*> &rhs);
     
     // choose what to remove
     enum TriCode { KEEP_TRI, DELETE_TRI, FLIP_TRI };
     void doDeleteAndFlip(
         std::function<TriCode(byte bool_alg_data)> classify
     );
+    // or apply the choice to a copy of the classified mesh
+    void doDeleteAndFlip(
+        Mesh *target,
+        std::function<TriCode(byte bool_alg_data)> classify
+    );
+    // or choose by evaluating a CSG expression (N-ary setup only)
+    void doDeleteAndFlip(
+        Mesh *target,
+        const std::vector<CSGNode> &expr
+    );
+    
+    // the choices for each operation
+    static TriCode unionCode(byte data) {
+        if((data & 2) == 2)     // part of op 0/1 INSIDE op 1/0
+            return DELETE_TRI;
+        else                    // part of op 0/1 OUTSIDE op 1/0
+            return KEEP_TRI;
+    }
+    static TriCode diffCode(byte data) {
+        if(data == 2 ||         // part of op 0 INSIDE op 1
+           data == 1)           // part of op 1 OUTSIDE op 0
+            return DELETE_TRI;
+        else if(data == 3)      // part of op 1 INSIDE op 1
+            return FLIP_TRI;
+        else                    // part of op 0 OUTSIDE op 1
+            return KEEP_TRI;
+    }
+    static TriCode isctCode(byte data) {
+        if((data & 2) == 0)     // part of op 0/1 OUTSIDE op 1/0
+            return DELETE_TRI;
+        else                    // part of op 0/1 INSIDE op 1/0
+            return KEEP_TRI;
+    }
+    static TriCode xorCode(byte data) {
+        if((data & 2) == 0)     // part of op 0/1 OUTSIDE op 1/0
+            return KEEP_TRI;
+        else                    // part of op 0/1 INSIDE op 1/0
+            return FLIP_TRI;
+    }
 
 private: // methods
     struct BoolEdata {
         bool is_isct;
     };
     
-    inline byte& boolData(uint tri_id) {
+    // during setup, this is just the operand the triangle came from
+    inline uint& boolData(uint tri_id) {
         return mesh->tris[tri_id].data.bool_alg_data;
     }
+    // is the triangle inside of the given operand?
+    // (one byte per operand per triangle, so that components
+    //  can be classified concurrently)
+    inline byte& inside(uint tri_id, uint operand) {
+        return inside_bits[tri_id * n_operands + operand];
+    }
     
-    void populateECache()
+    // isct_edges are the edges the resolve marked as intersection edges
+    void populateECache(const std::vector< std::pair<uint,uint> > &isct_edges)
     {
         ecache = mesh->createEGraphCache<BoolEdata>();
         
-        // label some of the edges as intersection edges and others as not
-        ecache.for_each([&](uint i, uint j, EGraphEntry<BoolEdata> &entry) {
+        ecache.for_each([&](uint, uint, EGraphEntry<BoolEdata> &entry) {
             entry.data.is_isct = false;
-            byte operand = boolData(entry.tids[0]);
-            for(uint k=1; k<entry.tids.size(); k++) {
-                if(boolData(entry.tids[k]) != operand) {
-                    entry.data.is_isct = true;
-                    break;
-                }
-            }
         });
+        for(const auto &e : isct_edges) {
+            ecache(e.first, e.second).data.is_isct = true;
+            ecache(e.second, e.first).data.is_isct = true;
+        }
     }
     
     inline void for_ecache(
@@ -77,44 +134,126 @@ private: // methods
     ) {
         ecache.for_each([&](uint i, uint j, EGraphEntry<BoolEdata> &entry) {
             if(entry.data.is_isct) {
-                ShortVec<uint, 2> tid0s;
-                ShortVec<uint, 2> tid1s;
-                for(uint tid : entry.tids) {
-                    if(boolData(tid) & 1)
-                        tid1s.push_back(tid);
-                    else
-                        tid0s.push_back(tid);
+                // split the triangles up by operand
+                ShortVec<uint, 2> rest = entry.tids;
+                while(rest.size() > 0) {
+                    uint operand = boolData(rest[0]);
+                    ShortVec<uint, 2> optids;
+                    ShortVec<uint, 2> others;
+                    for(uint tid : rest) {
+                        if(boolData(tid) == operand)
+                            optids.push_back(tid);
+                        else
+                            others.push_back(tid);
+                    }
+                    action(i,j, true, optids);
+                    rest = others;
                 }
-                action(i,j, true, tid1s);
-                action(i,j, true, tid0s);
             } else {
                 action(i,j, false, entry.tids);
             }
         });
     }
     
+    // build, for each operand, a hierarchy to evaluate winding numbers with
     void prepInsideOutsideTests()
     {
+        std::vector< std::vector<WindingTri> > wtris(n_operands);
+        for(uint i=0; i<mesh->tris.size(); i++) {
+            WindingTri wtri;
+            for(uint k=0; k<3; k++)
+                wtri.v[k] = mesh->verts[mesh->tris[i].v[k]].pos;
+            wtris[boolData(i)].push_back(wtri);
+        }
+        tri_bvhs.assign(n_operands, nullptr);
+        windings.assign(n_operands, nullptr);
+        for(uint op=0; op<n_operands; op++) {
+            if(wtris[op].size() > 0)
+                windings[op] = new FastWinding(wtris[op]);
+        }
+    }
+    
+    // The ray fallback is rarely needed, so the hierarchies over
+    // each operand's triangles to cast rays against are built on demand.
+    // (may be called from several threads at once)
+    AABVH<uint>* triBVH(uint op)
+    {
+        std::lock_guard<std::mutex> lock(tri_bvh_lock);
+        if(tri_bvhs[op])
+            return tri_bvhs[op];
+        
+        std::vector< GeomBlob<uint> > geoms;
+        for(uint i=0; i<mesh->tris.size(); i++) {
+            if(boolData(i) != op)   continue;
+            const Vec3d &p0 = mesh->verts[mesh->tris[i].a].pos;
+            const Vec3d &p1 = mesh->verts[mesh->tris[i].b].pos;
+            const Vec3d &p2 = mesh->verts[mesh->tris[i].c].pos;
+            // pad the boxes a little, so that rounding in the box test
+            // can't make us miss a triangle the ray test would have hit
+            Vec3d lo = min(p0, min(p1, p2));
+            Vec3d hi = max(p0, max(p1, p2));
+            Vec3d pad = 1.0e-9 * (max(abs(lo), abs(hi)) + Vec3d(1,1,1));
+            GeomBlob<uint> blob;
+            blob.bbox   = BBox3d(lo - pad, hi + pad);
+            blob.point  = (blob.bbox.minp + blob.bbox.maxp) / 2.0;
+            blob.id     = i;
+            geoms.push_back(blob);
+        }
+        tri_bvhs[op] = new AABVH<uint>(geoms, 1, &ctx->bvh);
+        return tri_bvhs[op];
     }
     
-    bool isInside(uint tid, byte operand) {
-        // find the point to trace outward from...
-        Vec3d p(0,0,0);
-        p += mesh->verts[mesh->tris[tid].a].pos;
-        p += mesh->verts[mesh->tris[tid].b].pos;
-        p += mesh->verts[mesh->tris[tid].c].pos;
-        p /= 3.0;
-        // ok, we've got the point, now let's pick a direction
+    // fills out the inside bits of every seed triangle
+    // for every other operand, in one batch per operand
+    void findInside(const std::vector<uint> &seeds)
+    {
+        // we test from the triangle centroids
+        std::vector<Vec3d> points(seeds.size());
+        for(uint i=0; i<seeds.size(); i++) {
+            const Tri &tri = mesh->tris[seeds[i]];
+            points[i] = (mesh->verts[tri.a].pos +
+                         mesh->verts[tri.b].pos +
+                         mesh->verts[tri.c].pos) / 3.0;
+        }
+        
+        std::vector<double> w;
+        std::vector<double> err;
+        for(uint op=0; op<n_operands; op++) {
+            if(!windings[op])   continue; // nothing to be inside of
+            windings[op]->windings(points, w, err, ctx->n_threads);
+            parallelFor(seeds.size(), ctx->n_threads, [&](uint i, uint) {
+                if(boolData(seeds[i]) == op)    return;
+                // The operands are closed, so the exact winding number
+                // is a whole number, and w[i] is within err[i] of it.
+                // If that doesn't settle which side of 0.5 it's on,
+                // sum exactly, and if the point is still too close
+                // to call, fall back on a ray
+                double wn = w[i];
+                if(fabs(wn - 0.5) <= err[i])
+                    wn = windings[op]->exactWinding(points[i]);
+                if(fabs(wn - 0.5) < 0.25)
+                    wn = rayWinding(seeds[i], points[i], op);
+                inside(seeds[i], op) = wn > 0.5;
+            }, 16);
+        }
+    }
+    
+    // count the signed crossings of a random ray from p
+    // with the triangles of tri_operand.  The direction is drawn
+    // from a stream seeded by tid and the context's random source,
+    // so it doesn't matter which thread gets here first.
+    int rayWinding(uint tid, const Vec3d &p, uint tri_operand) {
         Ray3d r;
         r.p = p;
-        r.r = Vec3d(drand(0.5,1.5), drand(0.5,1.5), drand(0.5, 1.5));
-        
+        RandomStream rand(ray_seed ^
+                          (0x9E3779B97F4A7C15ULL * (tid + 1ULL)));
+        r.r = Vec3d(rand.drand(0.5,1.5),
+                    rand.drand(0.5,1.5),
+                    rand.drand(0.5,1.5));
         
         int winding = 0;
-        // pass all triangles over ray
-        for(Tri &tri : mesh->tris) {
-            // ignore triangles from the same operand surface
-            if((tri.data.bool_alg_data & 1) == operand)   continue;
+        triBVH(tri_operand)->for_each_on_ray(r, [&](uint tri_id) {
+            const Tri &tri = mesh->tris[tri_id];
             
             double flip = 1.0;
             uint   a = tri.a;
@@ -138,15 +277,25 @@ private: // methods
                     winding--;
                 }
             }
-        }
-        
-        // now, we've got a winding number to work with...
-        return winding > 0;
+        });
+        return winding;
     }
     
+    void deleteAndFlip(
+        Mesh *target,
+        std::function<TriCode(uint tid)> classify
+    );
+    
 private: // data
     Mesh                        *mesh;
+    CorkContext                 *ctx;
     EGraphCache<BoolEdata>      ecache;
+    uint                        n_operands;
+    unsigned long long          ray_seed; // (drawn from ctx->random)
+    std::vector<byte>           inside_bits;
+    std::vector< AABVH<uint>* > tri_bvhs; // one per operand
+    std::mutex                  tri_bvh_lock;
+    std::vector<FastWinding*>   windings; // ditto
 };
 
 
@@ -156,29 +305,83 @@ static inline double triArea(
     return len(cross(b-a, c-a));
 }
 
+// evaluate the expression at a point, given which operands it is inside
+static inline bool evalCSG(
+    const std::vector<CSGNode> &expr,
+    const std::vector<bool> &point,
+    std::vector<bool> &values
+) {
+    values.resize(expr.size());
+    for(uint k=0; k<expr.size(); k++) {
+        const CSGNode &node = expr[k];
+        switch(node.op) {
+        case CSGNode::OPERAND:
+            values[k] = point[node.operand];                        break;
+        case CSGNode::UNION:
+            values[k] = values[node.left] || values[node.right];    break;
+        case CSGNode::DIFF:
+            values[k] = values[node.left] && !values[node.right];   break;
+        case CSGNode::ISCT:
+            values[k] = values[node.left] && values[node.right];    break;
+        case CSGNode::XOR:
+            values[k] = values[node.left] != values[node.right];    break;
+        }
+    }
+    return values.back();
+}
+
+
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::BoolProblem::doSetup(
+    const Mesh &rhs
+) {
+    std::vector<const Mesh*> operands(1, &rhs);
+    doSetup(operands);
+    
+    // pack the labels into two bits for the binary classifiers:
+    // the operand and whether it's inside the other operand
+    for(uint i=0; i<mesh->tris.size(); i++) {
+        uint operand = boolData(i);
+        if(inside(i, 1 - operand))
+            boolData(i) |= 2;
+    }
+}
 
 template<class VertData, class TriData>
 void Mesh<VertData,TriData>::BoolProblem::doSetup(
-    Mesh &rhs
+    const std::vector<const Mesh*> &rhs
 ) {
     // Label surfaces...
-    mesh->for_tris([](TriData &tri, VertData&, VertData&, VertData&) {
-        tri.bool_alg_data = 0;
-    });
-    rhs.for_tris([](TriData &tri, VertData&, VertData&, VertData&) {
-        tri.bool_alg_data = 1;
-    });
+    // (after the union, so that rhs is left untouched)
+    n_operands = rhs.size() + 1;
+    for(uint i=0; i<mesh->tris.size(); i++)
+        boolData(i) = 0;
+    for(uint k=0; k<rhs.size(); k++) {
+        uint start = mesh->tris.size();
+        mesh->disjointUnion(*rhs[k]);
+        for(uint i=start; i<mesh->tris.size(); i++)
+            boolData(i) = k + 1;
+    }
     
-    mesh->disjointUnion(rhs);
-    mesh->resolveIntersections();
+    // the resolve tells us which edges it cut along,
+    // so we don't have to rediscover them
+    std::vector< std::pair<uint,uint> > isct_edges;
+    if(ctx->validate_operands) {
+        mesh->resolveIntersections(ctx, &isct_edges);
+    } else {
+        std::vector<uint> operands(mesh->tris.size());
+        for(uint i=0; i<mesh->tris.size(); i++)
+            operands[i] = boolData(i);
+        mesh->resolveIntersections(ctx, operands, &isct_edges);
+    }
     
-    populateECache();
+    populateECache(isct_edges);
     
     // form connected components;
     // we get one component for each connected component in one
-    // of the two input meshes.
+    // of the input meshes.
     // These components are not necessarily uniformly inside or outside
-    // of the other operand mesh.
+    // of the other operand meshes.
     UnionFind uf(mesh->tris.size());
     for_ecache([&](uint, uint, bool, const ShortVec<uint, 2> &tids) {
         uint tid0 = tids[0];
@@ -203,11 +406,19 @@ void Mesh<VertData,TriData>::BoolProblem::doSetup(
         }
     }
     
-    std::vector<bool> visited(mesh->tris.size(), false);
+    std::vector<byte> visited(mesh->tris.size(), false);
+    inside_bits.assign(mesh->tris.size() * n_operands, false);
+    prepInsideOutsideTests();
     
     // find the "best" triangle in each component,
-    // and ray cast to determine inside-ness vs. outside-ness
-    for(auto &comp : components) {
+    // and classify all of them together.
+    // Components are disjoint, so they can all be worked on at once:
+    // each walk below only touches the visited and inside bytes of
+    // its own component's triangles (bytes, since the flags in a
+    // std::vector<bool> share words)
+    std::vector<uint> seeds(components.size());
+    parallelFor(components.size(), ctx->n_threads, [&](uint c, uint) {
+        auto &comp = components[c];
         // find max according to score
         uint best_tid = comp[0];
         double best_area = 0.0;
@@ -223,16 +434,20 @@ void Mesh<VertData,TriData>::BoolProblem::doSetup(
                 best_tid = tid;
             }
         }
-        
-        byte operand = boolData(best_tid);
-        bool inside = isInside(best_tid, operand);
+        seeds[c] = best_tid;
+    });
+    findInside(seeds);
+    
+    parallelFor(seeds.size(), ctx->n_threads, [&](uint c, uint) {
+        uint best_tid = seeds[c];
+        uint operand = boolData(best_tid);
         
         // NOW PROPAGATE classification throughout the component.
         // do a breadth first propagation
         std::queue<uint> work;
+        std::vector<bool> inside_sig(n_operands);
         
         // begin by tagging the first triangle
-        boolData(best_tid) |= (inside)? 2 : 0;
         visited[best_tid] = true;
         work.push(best_tid);
         
@@ -244,19 +459,35 @@ void Mesh<VertData,TriData>::BoolProblem::doSetup(
                 uint a = mesh->tris[curr_tid].v[k];
                 uint b = mesh->tris[curr_tid].v[(k+1)%3];
                 auto &entry = ecache(a,b);
-                byte inside_sig = boolData(curr_tid) & 2;
-                if(entry.data.is_isct)  inside_sig ^= 2;
+                for(uint op=0; op<n_operands; op++)
+                    inside_sig[op] = inside(curr_tid, op);
+                // crossing over another operand's surface
+                // flips whether we're inside of it
+                if(entry.data.is_isct) {
+                    ShortVec<uint, 4> crossed;
+                    for(uint tid : entry.tids) {
+                        uint tid_op = boolData(tid);
+                        if(tid_op == operand)                   continue;
+                        if(std::find(crossed.begin(), crossed.end(),
+                                     tid_op) != crossed.end())  continue;
+                        crossed.push_back(tid_op);
+                        inside_sig[tid_op] = !inside_sig[tid_op];
+                    }
+                }
+                // (the other operands' triangles belong to components
+                //  which other threads may be walking; leave them be)
                 for(uint tid : entry.tids) {
-                    if(visited[tid])                    continue;
-                    if((boolData(tid)&1) != operand)    continue;
+                    if(boolData(tid) != operand)    continue;
+                    if(visited[tid])                continue;
                     
-                    boolData(tid) |= inside_sig;
+                    for(uint op=0; op<n_operands; op++)
+                        inside(tid, op) = inside_sig[op];
                     visited[tid] = true;
                     work.push(tid);
                 }
             }
         }
-    }
+    });
 }
 
 
@@ -264,29 +495,104 @@ template<class VertData, class TriData>
 void Mesh<VertData,TriData>::BoolProblem::doDeleteAndFlip(
     std::function<TriCode(byte bool_alg_data)> classify
 ) {
-    TopoCache topocache(mesh);
-    
-    std::vector<Tptr> toDelete;
-    topocache.tris.for_each([&](Tptr tptr) {
-        TriCode code = classify(boolData(tptr->ref));
-        switch(code) {
-        case DELETE_TRI:
-            toDelete.push_back(tptr);
-            break;
-        case FLIP_TRI:
-            topocache.flipTri(tptr);
-            break;
-        case KEEP_TRI:
-        default:
-            break;
-        }
+    doDeleteAndFlip(mesh, classify);
+}
+
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::BoolProblem::doDeleteAndFlip(
+    Mesh *target,
+    std::function<TriCode(byte bool_alg_data)> classify
+) {
+    deleteAndFlip(target, [&](uint tid) -> TriCode {
+        return classify(target->tris[tid].data.bool_alg_data);
     });
+}
+
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::BoolProblem::doDeleteAndFlip(
+    Mesh *target,
+    const std::vector<CSGNode> &expr
+) {
+    // A triangle's surface bounds the result exactly when the expression
+    // changes value as we cross from inside its operand to outside.
+    // Lots of triangles share the same labels, so remember the answers
+    std::map< std::vector<bool>, TriCode > memo;
+    std::vector<bool> point(n_operands);
+    std::vector<bool> values;
+    deleteAndFlip(target, [&](uint tid) -> TriCode {
+        uint operand = target->tris[tid].data.bool_alg_data;
+        for(uint k=0; k<n_operands; k++)
+            point[k] = inside(tid, k);
+        point[operand] = false;
+        // tack on which operand this is to make the key unique
+        std::vector<bool> key = point;
+        key.resize(n_operands * 2, false);
+        key[n_operands + operand] = true;
+        
+        auto it = memo.find(key);
+        if(it != memo.end())
+            return it->second;
+        
+        bool outside_val = evalCSG(expr, point, values);
+        point[operand] = true;
+        bool inside_val  = evalCSG(expr, point, values);
+        
+        TriCode code;
+        if(inside_val == outside_val)   code = DELETE_TRI;
+        else if(inside_val)             code = KEEP_TRI;
+        else                            code = FLIP_TRI;
+        memo[key] = code;
+        return code;
+    });
+}
+
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::BoolProblem::deleteAndFlip(
+    Mesh *target,
+    std::function<TriCode(uint tid)> classify
+) {
+    // Neither deleting nor flipping needs any connectivity,
+    // so we just filter the triangle array in place.
+    // A vertex goes away once only deleted triangles use it.
+    // (0: unused to begin with, 1: only deleted tris, 2: kept)
+    std::vector<byte> vert_use(target->verts.size(), 0);
+    uint write = 0;
+    for(uint read = 0; read < target->tris.size(); read++) {
+        Tri &tri = target->tris[read];
+        TriCode code = classify(read);
+        if(code == DELETE_TRI) {
+            for(uint k=0; k<3; k++)
+                vert_use[tri.v[k]] = std::max<byte>(vert_use[tri.v[k]], 1);
+            continue;
+        }
+        if(code == FLIP_TRI)
+            std::swap(tri.v[0], tri.v[1]);
+        for(uint k=0; k<3; k++)
+            vert_use[tri.v[k]] = 2;
+        if(write != read)
+            target->tris[write] = tri;
+        write++;
+    }
+    target->tris.resize(write);
     
-    for(Tptr tptr : toDelete) {
-        topocache.deleteTri(tptr);
+    // compact the vertices and build a remapping function
+    std::vector<uint> vmap(target->verts.size());
+    write = 0;
+    for(uint read = 0; read < target->verts.size(); read++) {
+        if(vert_use[read] == 1) {
+            vmap[read] = INVALID_ID;
+            continue;
+        }
+        vmap[read] = write;
+        if(write != read)
+            target->verts[write] = target->verts[read];
+        write++;
     }
+    target->verts.resize(write);
     
-    topocache.commit();
+    for(Tri &tri : target->tris)
+        for(uint k=0; k<3; k++)
+            tri.v[k] = vmap[tri.v[k]];
 }
 
 
@@ -294,69 +600,88 @@ void Mesh<VertData,TriData>::BoolProblem::doDeleteAndFlip(
 
 
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::boolUnion(Mesh &rhs)
+void Mesh<VertData,TriData>::boolUnion(const Mesh &rhs, CorkContext *ctx)
 {
-    BoolProblem bprob(this);
+    BoolProblem bprob(this, ctx);
     
     bprob.doSetup(rhs);
     
-    bprob.doDeleteAndFlip([](byte data) -> typename BoolProblem::TriCode {
-        if((data & 2) == 2)     // part of op 0/1 INSIDE op 1/0
-            return BoolProblem::DELETE_TRI;
-        else                    // part of op 0/1 OUTSIDE op 1/0
-            return BoolProblem::KEEP_TRI;
-    });
+    bprob.doDeleteAndFlip(BoolProblem::unionCode);
 }
 
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::boolDiff(Mesh &rhs)
+void Mesh<VertData,TriData>::boolDiff(const Mesh &rhs, CorkContext *ctx)
 {
-    BoolProblem bprob(this);
+    BoolProblem bprob(this, ctx);
     
     bprob.doSetup(rhs);
     
-    bprob.doDeleteAndFlip([](byte data) -> typename BoolProblem::TriCode {
-        if(data == 2 ||         // part of op 0 INSIDE op 1
-           data == 1)           // part of op 1 OUTSIDE op 0
-            return BoolProblem::DELETE_TRI;
-        else if(data == 3)      // part of op 1 INSIDE op 1
-            return BoolProblem::FLIP_TRI;
-        else                    // part of op 0 OUTSIDE op 1
-            return BoolProblem::KEEP_TRI;
-    });
+    bprob.doDeleteAndFlip(BoolProblem::diffCode);
 }
 
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::boolIsct(Mesh &rhs)
+void Mesh<VertData,TriData>::boolIsct(const Mesh &rhs, CorkContext *ctx)
 {
-    BoolProblem bprob(this);
+    BoolProblem bprob(this, ctx);
     
     bprob.doSetup(rhs);
     
-    bprob.doDeleteAndFlip([](byte data) -> typename BoolProblem::TriCode {
-        if((data & 2) == 0)     // part of op 0/1 OUTSIDE op 1/0
-            return BoolProblem::DELETE_TRI;
-        else                    // part of op 0/1 INSIDE op 1/0
-            return BoolProblem::KEEP_TRI;
-    });
+    bprob.doDeleteAndFlip(BoolProblem::isctCode);
 }
 
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::boolXor(Mesh &rhs)
+void Mesh<VertData,TriData>::boolXor(const Mesh &rhs, CorkContext *ctx)
 {
-    BoolProblem bprob(this);
+    BoolProblem bprob(this, ctx);
     
     bprob.doSetup(rhs);
     
-    bprob.doDeleteAndFlip([](byte data) -> typename BoolProblem::TriCode {
-        if((data & 2) == 0)     // part of op 0/1 OUTSIDE op 1/0
-            return BoolProblem::KEEP_TRI;
-        else                    // part of op 0/1 INSIDE op 1/0
-            return BoolProblem::FLIP_TRI;
-    });
+    bprob.doDeleteAndFlip(BoolProblem::xorCode);
 }
 
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::boolMulti(
+    const Mesh &rhs, CorkContext *ctx,
+    Mesh *union_out, Mesh *diff_out, Mesh *isct_out, Mesh *xor_out
+) const {
+    Mesh work(*this);
+    BoolProblem bprob(&work, ctx);
+    
+    bprob.doSetup(rhs);
+    
+    // Every result starts from the same classified mesh.
+    // The last one requested can just take over the working copy.
+    std::vector< std::pair<Mesh*, typename BoolProblem::TriCode(*)(byte)> >
+        outputs;
+    if(union_out)   outputs.push_back(
+                        std::make_pair(union_out, BoolProblem::unionCode));
+    if(diff_out)    outputs.push_back(
+                        std::make_pair(diff_out, BoolProblem::diffCode));
+    if(isct_out)    outputs.push_back(
+                        std::make_pair(isct_out, BoolProblem::isctCode));
+    if(xor_out)     outputs.push_back(
+                        std::make_pair(xor_out, BoolProblem::xorCode));
+    
+    for(uint k=0; k<outputs.size(); k++) {
+        Mesh *out = outputs[k].first;
+        if(k+1 < outputs.size())    *out = work;
+        else                        *out = std::move(work);
+        bprob.doDeleteAndFlip(out, outputs[k].second);
+    }
+}
 
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::boolCSG(
+    const std::vector<const Mesh*> &rhs,
+    const std::vector<CSGNode> &expr,
+    CorkContext *ctx
+) {
+    BoolProblem bprob(this, ctx);
+    
+    bprob.doSetup(rhs);
+    
+    bprob.doDeleteAndFlip(this, expr);
+}
 
 
 
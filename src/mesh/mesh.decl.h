@@ -37,14 +37,44 @@
 
 #include "iterPool.h"
 
+#include "empty3d.h"
+#include "aabvh.h"
+
+
+// All of the mutable state used while computing on meshes.
+// Computations using separate contexts may run concurrently,
+// but a single context must only be used by one computation at a time.
+struct CorkContext {
+    Empty3d::ExactArithmeticContext     arith;
+    RandomStream                        random;
+    // Boolean operations normally assume each operand is free of
+    // self-intersections and only intersect operands with each other.
+    // Set this to resolve self-intersections within operands as well
+    bool                                validate_operands;
+    // how many threads an operation may use (0 means all of them)
+    uint                                n_threads;
+    // children per node of the box-query hierarchies (2, 4 or 8)
+    uint                                bvh_width;
+    AABVHStats                          bvh;
+    
+    CorkContext() : validate_operands(false), n_threads(0), bvh_width(4) {}
+};
 
 struct BoolVertexData {
 };
 struct BoolTriangleData {
-    byte bool_alg_data; // internal use by algorithm
+    uint bool_alg_data; // internal use by algorithm
         // please copy value when the triangle is subdivided
 };
 
+// one node of an N-ary CSG expression (see Mesh::boolCSG)
+struct CSGNode {
+    enum Op { OPERAND, UNION, DIFF, ISCT, XOR };
+    Op      op;
+    uint    operand;        // which operand, for OPERAND nodes
+    uint    left, right;    // child nodes, which must come earlier
+};
+
 
 template<class VertData, class TriData>
 struct IsctVertEdgeTriInput
@@ -147,10 +177,12 @@ class Mesh
 public:
     Mesh();
     Mesh(Mesh &&src);
+    Mesh(const Mesh &src);
     Mesh(const RawMesh<VertData,TriData> &raw);
     virtual ~Mesh();
     
     void operator=(Mesh &&src);
+    void operator=(const Mesh &src);
     
     // validity check:
     //  - all numbers are well-defined and finite
@@ -162,6 +194,19 @@ public:
     inline int numVerts() const { return verts.size(); }
     inline int numTris() const { return tris.size(); }
     
+    // direct access to the vertex and triangle arrays,
+    // for bulk import/export without going through a RawMesh
+    inline void resize(uint nverts, uint ntris) {
+        verts.resize(nverts);
+        tris.resize(ntris);
+    }
+    inline       VertData& vertex(uint vid)       { return verts[vid]; }
+    inline const VertData& vertex(uint vid) const { return verts[vid]; }
+    inline       TriData& triangle(uint tid)       { return tris[tid].data; }
+    inline const TriData& triangle(uint tid) const { return tris[tid].data; }
+    inline       uint* triVerts(uint tid)       { return tris[tid].v; }
+    inline const uint* triVerts(uint tid) const { return tris[tid].v; }
+    
     inline void for_verts(std::function<void(VertData &)> func);
     inline void for_tris(std::function<void(TriData &,
                           VertData &, VertData &, VertData &)> func);
@@ -198,20 +243,44 @@ public: // REMESHING module
     RemeshOptions remesh_options;
     
 public: // ISCT (intersections) module
-    void resolveIntersections(); // makes all intersections explicit
-    bool isSelfIntersecting(); // is the mesh self-intersecting?
+    // makes all intersections explicit;
+    // if isct_edges is given, it receives the edges (as vertex id pairs)
+    // that the intersections cut or split
+    void resolveIntersections(CorkContext *ctx,
+               std::vector< std::pair<uint,uint> > *isct_edges = nullptr);
+    // only makes intersections between different operands explicit;
+    // operands gives an operand label for each triangle
+    void resolveIntersections(CorkContext *ctx,
+               const std::vector<uint> &operands,
+               std::vector< std::pair<uint,uint> > *isct_edges = nullptr);
+    // is the mesh self-intersecting?
+    bool isSelfIntersecting(CorkContext *ctx);
     // TESTING
-    void testingComputeStaticIsctPoints(std::vector<Vec3d> *points);
-    void testingComputeStaticIsct(std::vector<Vec3d> *points,
+    void testingComputeStaticIsctPoints(CorkContext *ctx,
+               std::vector<Vec3d> *points);
+    void testingComputeStaticIsct(CorkContext *ctx,
+               std::vector<Vec3d> *points,
                std::vector< std::pair<Vec3d,Vec3d> > *edges);
     
 public: // BOOLean operation module
     // all of the form
     //      this = this OP rhs
-    void boolUnion(Mesh &rhs);
-    void boolDiff(Mesh &rhs);
-    void boolIsct(Mesh &rhs);
-    void boolXor(Mesh &rhs);
+    void boolUnion(const Mesh &rhs, CorkContext *ctx);
+    void boolDiff(const Mesh &rhs, CorkContext *ctx);
+    void boolIsct(const Mesh &rhs, CorkContext *ctx);
+    void boolXor(const Mesh &rhs, CorkContext *ctx);
+    // computes any subset of the above from a single resolve and
+    // classification pass, leaving this unchanged.
+    // pass null for the results which aren't wanted
+    void boolMulti(const Mesh &rhs, CorkContext *ctx,
+                   Mesh *union_out, Mesh *diff_out,
+                   Mesh *isct_out,  Mesh *xor_out) const;
+    // N-ary CSG, where this is operand 0 and rhs[k] is operand k+1.
+    // All operands are resolved against each other in a single pass,
+    // then the expression is evaluated to decide which triangles to
+    // keep.  The last node of expr is the root.
+    void boolCSG(const std::vector<const Mesh*> &rhs,
+                 const std::vector<CSGNode> &expr, CorkContext *ctx);
     
 private:    // Internal Formats
     struct Tri {
@@ -231,6 +300,12 @@ private:    // Internal Formats
     inline void move_tri(Tri &t_new, Tri &t_old);
     inline void subdivide_tri(uint t_piece_ref, uint t_parent_ref);
     
+    // marks the triangles whose (padded) boxes overlap a triangle
+    // from another operand, and returns how many there are
+    uint findOverlapTris(CorkContext *ctx,
+                         const std::vector<uint> &operands, double pad,
+                         std::vector<bool> *overlaps) const;
+    
 private:    // DATA
     std::vector<Tri>        tris;
     std::vector<VertData>   verts;
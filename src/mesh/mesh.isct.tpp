@@ -32,6 +32,7 @@
 #include "empty3d.h"
 
 #include "aabvh.h"
+#include "parallel.h"
 
 #define REAL double
 extern "C" {
@@ -126,6 +127,7 @@ struct GluePointMarker
                                            // false if tri-tri-tri
     Eptr                    e;
     Tptr                    t[3];
+    Vec3d                   coord; // shared by all the copies
 };
 
 
@@ -174,6 +176,50 @@ inline bool hasCommonVert(Eptr e, Tptr t)
             e->verts[1] == t->verts[2]);
 }
 
+// Orientation of the 2d triangle (a,b,c); positive if counter-clockwise.
+// Returns 0 whenever floating point can't be sure of the sign
+// (the error bound is the one Triangle's exact predicates start with)
+inline int orient2dFilter(const double *a, const double *b, const double *c)
+{
+    double detleft  = (a[0] - c[0]) * (b[1] - c[1]);
+    double detright = (a[1] - c[1]) * (b[0] - c[0]);
+    double det      = detleft - detright;
+    double bound    = (3.0 + 16.0*DBL_EPSILON) * DBL_EPSILON *
+                      (fabs(detleft) + fabs(detright));
+    if(det >  bound)    return  1;
+    if(det < -bound)    return -1;
+    return 0;
+}
+
+// Whether d is inside the circle through the counter-clockwise
+// 2d triangle (a,b,c); positive if so, and 0 if floating point
+// can't be sure (again with the error bound from Triangle)
+inline int incircleFilter(const double *a, const double *b,
+                          const double *c, const double *d)
+{
+    double adx = a[0] - d[0],   ady = a[1] - d[1];
+    double bdx = b[0] - d[0],   bdy = b[1] - d[1];
+    double cdx = c[0] - d[0],   cdy = c[1] - d[1];
+    
+    double bdxcdy = bdx * cdy,  cdxbdy = cdx * bdy;
+    double cdxady = cdx * ady,  adxcdy = adx * cdy;
+    double adxbdy = adx * bdy,  bdxady = bdx * ady;
+    double alift  = adx * adx + ady * ady;
+    double blift  = bdx * bdx + bdy * bdy;
+    double clift  = cdx * cdx + cdy * cdy;
+    
+    double det    = alift * (bdxcdy - cdxbdy)
+                  + blift * (cdxady - adxcdy)
+                  + clift * (adxbdy - bdxady);
+    double perm   = (fabs(bdxcdy) + fabs(cdxbdy)) * alift
+                  + (fabs(cdxady) + fabs(adxcdy)) * blift
+                  + (fabs(adxbdy) + fabs(bdxady)) * clift;
+    double bound  = (10.0 + 96.0*DBL_EPSILON) * DBL_EPSILON * perm;
+    if(det >  bound)    return  1;
+    if(det < -bound)    return -1;
+    return 0;
+}
+
 inline void disconnectGE(GEptr ge)
 {
     ge->ends[0]->edges.erase(ge);
@@ -235,7 +281,7 @@ public:
     IVptr addInteriorEndpoint(
         IsctProblem *iprob, Eptr edge, GluePt glue
     ) {
-        IVptr       iv              = iprob->newIsctVert(edge, the_tri, glue);
+        IVptr       iv              = iprob->newIsctVert(glue);
                     iv->boundary    = false;
                     iverts.push_back(iv);
         for(Tptr tri_key : edge->tris) {
@@ -274,8 +320,7 @@ public:
     void addInteriorPoint(
         IsctProblem *iprob, Tptr t0, Tptr t1, GluePt glue
     ) {
-        // note this generates wasted re-computation of coordinates 3X
-        IVptr       iv              = iprob->newIsctVert(the_tri, t0, t1, glue);
+        IVptr       iv              = iprob->newIsctVert(glue);
                     iv->boundary    = false;
                     iverts.push_back(iv);
         // find the 2 interior edges
@@ -318,9 +363,10 @@ public:
                         std::cout << iprob->vPos(ie->other_tri_key->verts[k])
                                   << std::endl;
                     std::cout << "degen count:"
-                              << Empty3d::degeneracy_count << std::endl;
+                              << iprob->context()->arith.degeneracy_count
+                              << std::endl;
                     std::cout << "exact count: "
-                              << Empty3d::exact_count << std::endl;
+                              << iprob->context()->arith.exact_count << std::endl;
                 }
                 ENSURE(vert); // bad if we can't find a common vertex
                 // then, find the corresponding OVptr, and connect
@@ -343,9 +389,14 @@ public:
         return true;
     }
     
-    void subdivide(IsctProblem *iprob) {
+    // Subdividing happens in three steps.  Preparing and emitting the
+    // subdivision create and release shared vertices, edges and triangles
+    // so they must run one problem at a time.  Solving touches nothing
+    // outside of this problem, so many problems may be solved at once.
+    void prepareSubdivision(IsctProblem *iprob) {
         // collect all the points, and create more points as necessary
-        ShortVec<GVptr, 7> points;
+        ShortVec<GVptr, 7> &points = sub_points;
+        points.resize(0);
         for(uint k=0; k<3; k++) {
             points.push_back(overts[k]);
             //std::cout << k << ": id " << overts[k]->concrete->ref << std::endl;
@@ -423,31 +474,43 @@ public:
         uint dim1 = (normdim+2)%3;
         double sign_flip = (normal.v[normdim] < 0.0)? -1.0 : 1.0;
         
+        // marshall the points and segments, since the vertices and edges
+        // may be shared with (and re-indexed by) neighboring problems
+        sub_coords.resize(points.size() * 2);
+        sub_point_markers.resize(points.size());
+        for(uint k=0; k<points.size(); k++) {
+            sub_coords[k*2 + 0] = points[k]->coord.v[dim0];
+            sub_coords[k*2 + 1] = points[k]->coord.v[dim1] * sign_flip;
+            sub_point_markers[k] = (points[k]->boundary)? 1 : 0;
+        }
+        sub_segments.resize(edges.size() * 2);
+        sub_segment_markers.resize(edges.size());
+        for(uint k=0; k<edges.size(); k++) {
+            sub_segments[k*2 + 0] = edges[k]->ends[0]->idx;
+            sub_segments[k*2 + 1] = edges[k]->ends[1]->idx;
+            sub_segment_markers[k] = (edges[k]->boundary)? 1 : 0;
+        }
+    }
+    
+    void solveSubdivision() {
+        if(solveSmallSubdivision())
+            return;
+        
         struct triangulateio in, out;
         
         /* Define input points. */
-        in.numberofpoints           = points.size();
+        in.numberofpoints           = sub_point_markers.size();
         in.numberofpointattributes  = 0;
-        in.pointlist                = new REAL[in.numberofpoints * 2];
+        in.pointlist                = sub_coords.data();
         in.pointattributelist       = nullptr;
-        in.pointmarkerlist          = new int[in.numberofpoints];
-        for(int k=0; k<in.numberofpoints; k++) {
-            in.pointlist[k*2 + 0] = points[k]->coord.v[dim0];
-            in.pointlist[k*2 + 1] = points[k]->coord.v[dim1] * sign_flip;
-            in.pointmarkerlist[k] = (points[k]->boundary)? 1 : 0;
-        }
+        in.pointmarkerlist          = sub_point_markers.data();
         
         /* Define the input segments */
-        in.numberofsegments = edges.size();
+        in.numberofsegments = sub_segment_markers.size();
         in.numberofholes = 0;// yes, zero
         in.numberofregions = 0;// not using regions
-        in.segmentlist = new int[in.numberofsegments * 2];
-        in.segmentmarkerlist = new int[in.numberofsegments];
-        for(int k=0; k<in.numberofsegments; k++) {
-            in.segmentlist[k*2 + 0] = edges[k]->ends[0]->idx;
-            in.segmentlist[k*2 + 1] = edges[k]->ends[1]->idx;
-            in.segmentmarkerlist[k] = (edges[k]->boundary)? 1 : 0;
-        }
+        in.segmentlist = sub_segments.data();
+        in.segmentmarkerlist = sub_segment_markers.data();
         
         // to be safe... declare 0 triangle attributes on input
         in.numberoftriangles = 0;
@@ -469,17 +532,17 @@ public:
         // solve the triangulation problem
         char *params = (char*)("pzQYY");
         //char *debug_params = (char*)("pzYYVC");
-        triangulate(params, &in, &out, nullptr);
+        ::triangulate(params, &in, &out, nullptr);
         
         if(out.numberofpoints != in.numberofpoints) {
             std::cout << "out.numberofpoints: "
                       << out.numberofpoints << std::endl;
-            std::cout << "points.size(): " << points.size() << std::endl;
+            std::cout << "points.size(): " << sub_points.size() << std::endl;
             std::cout << "dumping out the points' coordinates" << std::endl;
-            for(uint k=0; k<points.size(); k++) {
-                GVptr gv = points[k];
+            for(uint k=0; k<sub_points.size(); k++) {
+                GVptr gv = sub_points[k];
                 std::cout << "  " << gv->coord
-                          << "  " << gv->idx << std::endl;
+                          << "  " << k << std::endl;
             }
             
             std::cout << "dumping out the segments" << std::endl;
@@ -507,22 +570,11 @@ public:
         //std::cout << "number of triangles out: " << out.numberoftriangles
         //          << std::endl;
         
-        gtris.resize(out.numberoftriangles);
-        for(int k=0; k<out.numberoftriangles; k++) {
-            GVptr       gv0         = points[out.trianglelist[(k*3)+0]];
-            GVptr       gv1         = points[out.trianglelist[(k*3)+1]];
-            GVptr       gv2         = points[out.trianglelist[(k*3)+2]];
-                        gtris[k]    = iprob->newGenericTri(gv0, gv1, gv2);
-        }
-        
+        sub_tris.assign(out.trianglelist,
+                        out.trianglelist + out.numberoftriangles * 3);
         
         // clean up after triangulate...
-            // in free
-        free(in.pointlist);
-        free(in.pointmarkerlist);
-        free(in.segmentlist);
-        free(in.segmentmarkerlist);
-            // out free
+            // (the input arrays belong to this problem)
         free(out.pointlist);
         //free(out.pointattributelist);
         free(out.pointmarkerlist);
@@ -536,6 +588,331 @@ public:
         //free(out.edgemarkerlist);
     }
 
+    // Most problems only have one or two intersection curves crossing
+    // the triangle, each entering and leaving through the boundary.
+    // We triangulate those directly: cut the triangle into pieces along
+    // the curves, clip ears off each of the pieces, and then flip edges
+    // until we have the constrained Delaunay triangulation, i.e. the
+    // same one Triangle would have given us.  Anything more
+    // complicated, or anything which comes close to being degenerate,
+    // is left to Triangle.  Returns false if it gave up.
+    static const uint SMALL_SUBDIVISION = 12;
+    typedef ShortVec<int, SMALL_SUBDIVISION> SmallPoly;
+    bool solveSmallSubdivision() {
+        uint            n_points    = sub_point_markers.size();
+        uint            n_segs      = sub_segment_markers.size();
+        if(n_points > SMALL_SUBDIVISION)
+            return false;
+        
+        // every point must have two boundary neighbors if it's on the
+        // boundary, and two interior neighbors if it's not.
+        int             bnbrs[SMALL_SUBDIVISION][2];
+        int             inbrs[SMALL_SUBDIVISION][2];
+        uint            n_inbrs[SMALL_SUBDIVISION];
+        uint            n_boundary  = 0;
+        for(uint k=0; k<n_points; k++) {
+            bnbrs[k][0] = bnbrs[k][1] = -1;
+            n_inbrs[k] = 0;
+            if(sub_point_markers[k])    n_boundary++;
+        }
+        for(uint s=0; s<n_segs; s++) {
+            for(uint i=0; i<2; i++) {
+                int a = sub_segments[2*s + i];
+                int b = sub_segments[2*s + (1-i)];
+                if(sub_segment_markers[s]) {
+                    if(bnbrs[a][0] < 0)         bnbrs[a][0] = b;
+                    else if(bnbrs[a][1] < 0)    bnbrs[a][1] = b;
+                    else                        return false;
+                } else if(sub_point_markers[a]) {
+                    n_inbrs[a]++; // boundary points may have any number
+                } else {
+                    if(n_inbrs[a] >= 2)         return false;
+                    inbrs[a][n_inbrs[a]++] = b;
+                }
+            }
+        }
+        for(uint k=0; k<n_points; k++) {
+            if(!sub_point_markers[k] && n_inbrs[k] != 2)
+                return false;
+        }
+        
+        // walk the boundary
+        SmallPoly       boundary;
+        int             prev        = bnbrs[0][1];
+        int             cur         = 0;
+        do {
+            if(cur < 0 || boundary.size() >= n_boundary)
+                return false;
+            boundary.push_back(cur);
+            int         next        = (bnbrs[cur][0] == prev)?
+                                        bnbrs[cur][1] : bnbrs[cur][0];
+                        prev        = cur;
+                        cur         = next;
+        } while(cur != 0);
+        if(boundary.size() != n_boundary)
+            return false;
+        // make it counter-clockwise, judging by the corners (points 0,1,2)
+        int             corners     = orient2dFilter(sub_coords.data(),
+                                                     sub_coords.data() + 2,
+                                                     sub_coords.data() + 4);
+        uint            pos1        = 0;
+        while(boundary[pos1] != 1)  pos1++;
+        uint            pos2        = 0;
+        while(boundary[pos2] != 2)  pos2++;
+        if(corners == 0)
+            return false;
+        if((corners > 0) != (pos1 < pos2))
+            std::reverse(boundary.begin() + 1, boundary.end());
+        
+        // cut the triangle along each curve, starting from
+        // a segment leaving the boundary
+        ShortVec<SmallPoly, 4> pieces;
+        pieces.push_back(boundary);
+        uint            n_used      = 0;
+        for(uint s=0; s<n_segs; s++) {
+            if(sub_segment_markers[s])      continue;
+            int         a           = sub_segments[2*s + 0];
+            int         b           = sub_segments[2*s + 1];
+            if(!sub_point_markers[a])       std::swap(a, b);
+            if(!sub_point_markers[a])       continue;
+            // follow the curve to the boundary
+            SmallPoly   curve;
+            int         from        = a;
+            cur = b;
+            while(!sub_point_markers[cur]) {
+                if(curve.size() >= n_points)    return false; // loop
+                curve.push_back(cur);
+                int     next        = (inbrs[cur][0] == from)?
+                                        inbrs[cur][1] : inbrs[cur][0];
+                        from        = cur;
+                        cur         = next;
+            }
+            b = cur;
+            if(a == b)
+                return false;
+            // each curve is found from both of its ends; take it once
+            if(curve.size() > 0 && a > b)
+                continue;
+            n_used += curve.size() + 1;
+            if(!cutPiece(pieces, a, b, curve))
+                return false;
+        }
+        // make sure every segment was accounted for (so no closed loops)
+        if(n_used + n_boundary != n_segs)
+            return false;
+        
+        ShortVec<int, 3*2*SMALL_SUBDIVISION> tris;
+        for(SmallPoly &piece : pieces) {
+            if(!clipEars(piece, tris))
+                return false;
+        }
+        
+        // double check the count (Euler's formula)
+        uint            n_interior  = n_points - n_boundary;
+        if(tris.size() != 3*(n_boundary + 2*n_interior - 2))
+            return false;
+        if(!flipToDelaunay(tris))
+            return false;
+        sub_tris.assign(tris.begin(), tris.end());
+        return true;
+    }
+    // split the one piece with both a and b on its boundary in two,
+    // along the curve from a to b
+    bool cutPiece(ShortVec<SmallPoly, 4> &pieces,
+                  int a, int b, const SmallPoly &curve) {
+        uint            found       = pieces.size();
+        uint            i = 0, j = 0;
+        for(uint p=0; p<pieces.size(); p++) {
+            SmallPoly   &piece      = pieces[p];
+            uint        n           = piece.size();
+            uint        pa = n, pb = n;
+            for(uint k=0; k<n; k++) {
+                if(piece[k] == a)   pa = k;
+                if(piece[k] == b)   pb = k;
+            }
+            if(pa == n || pb == n)  continue;
+            if(found < pieces.size())
+                return false; // ambiguous
+            found = p;
+            i = std::min(pa, pb);
+            j = std::max(pa, pb);
+        }
+        if(found == pieces.size())
+            return false;
+        
+        SmallPoly       &piece      = pieces[found];
+        uint            n           = piece.size();
+        bool            forward     = (piece[i] == a);
+        SmallPoly       first, second;
+        for(uint k=i; k<=j; k++)
+            first.push_back(piece[k]);
+        for(uint k=0; k<curve.size(); k++) // from piece[j] to piece[i]
+            first.push_back(curve[forward? curve.size()-1-k : k]);
+        for(uint k=j; k<n+i+1; k++)
+            second.push_back(piece[k % n]);
+        for(uint k=0; k<curve.size(); k++) // from piece[i] to piece[j]
+            second.push_back(curve[forward? k : curve.size()-1-k]);
+        if(first.size() < 3 || second.size() < 3)
+            return false;
+        
+        pieces[found] = first;
+        pieces.push_back(second);
+        return true;
+    }
+    // triangulate a counter-clockwise polygon, if it's clearly simple
+    bool clipEars(SmallPoly &poly,
+                  ShortVec<int, 3*2*SMALL_SUBDIVISION> &tris) {
+        const REAL      *xy         = sub_coords.data();
+        auto orient = [&](int a, int b, int c) -> int {
+            return orient2dFilter(xy + 2*a, xy + 2*b, xy + 2*c);
+        };
+        uint            n           = poly.size();
+        
+        // no two sides may come close to touching,
+        // and the boundary may not double back on itself
+        for(uint i=0; i<n; i++) {
+            int         a0 = poly[i],   a1 = poly[(i+1) % n];
+            int         a2 = poly[(i+2) % n];
+            if(orient(a0, a1, a2) == 0) {
+                const REAL  *p0 = xy + 2*a0,    *p1 = xy + 2*a1;
+                const REAL  *p2 = xy + 2*a2;
+                if((p1[0] - p0[0]) * (p2[0] - p1[0]) +
+                   (p1[1] - p0[1]) * (p2[1] - p1[1]) <= 0.0)
+                    return false;
+            }
+            for(uint j=i+2; j<n; j++) {
+                if((j+1) % n == i)  continue;
+                int     b0 = poly[j],   b1 = poly[(j+1) % n];
+                int     sa0 = orient(b0, b1, a0),   sa1 = orient(b0, b1, a1);
+                int     sb0 = orient(a0, a1, b0),   sb1 = orient(a0, a1, b1);
+                bool    apart = (sa0 != 0 && sa0 == sa1) ||
+                                (sb0 != 0 && sb0 == sb1);
+                if(!apart)  return false;
+            }
+        }
+        // and it must go counter-clockwise, as seen from its
+        // lowest leftmost corner
+        uint            low         = 0;
+        for(uint k=1; k<n; k++) {
+            const REAL  *p = xy + 2*poly[k],    *q = xy + 2*poly[low];
+            if(p[0] < q[0] || (p[0] == q[0] && p[1] < q[1]))
+                low = k;
+        }
+        if(orient(poly[(low+n-1) % n], poly[low], poly[(low+1) % n]) <= 0)
+            return false;
+        
+        while(n > 3) {
+            uint        ear         = 0;
+            for(; ear<n; ear++) {
+                int     a  = poly[(ear+n-1) % n];
+                int     b  = poly[ear];
+                int     c  = poly[(ear+1) % n];
+                if(orient(a, b, c) <= 0)    continue;
+                // no other corner may be anywhere near the ear
+                bool    clear       = true;
+                for(uint k=0; k<n && clear; k++) {
+                    int     d = poly[k];
+                    if(d == a || d == b || d == c)  continue;
+                    clear = orient(a, b, d) < 0 ||
+                            orient(b, c, d) < 0 ||
+                            orient(c, a, d) < 0;
+                }
+                if(clear)   break;
+            }
+            if(ear == n)
+                return false;
+            tris.push_back(poly[(ear+n-1) % n]);
+            tris.push_back(poly[ear]);
+            tris.push_back(poly[(ear+1) % n]);
+            for(uint k=ear; k+1<n; k++)
+                poly[k] = poly[k+1];
+            poly.resize(--n);
+        }
+        if(orient(poly[0], poly[1], poly[2]) <= 0)
+            return false;
+        tris.push_back(poly[0]);
+        tris.push_back(poly[1]);
+        tris.push_back(poly[2]);
+        return true;
+    }
+    // Lawson's flips: any edge which isn't one of the input segments,
+    // and whose opposite corners are inside each other's circumcircle,
+    // is replaced by the other diagonal.  The result is unique unless
+    // four points are cocircular, so we give up on those (and on
+    // anything the filter can't be sure about)
+    bool flipToDelaunay(ShortVec<int, 3*2*SMALL_SUBDIVISION> &tris) {
+        const REAL      *xy         = sub_coords.data();
+        uint            n_segs      = sub_segment_markers.size();
+        uint            n_tris      = tris.size() / 3;
+        auto isSegment = [&](int u, int v) -> bool {
+            for(uint s=0; s<n_segs; s++) {
+                int     a = sub_segments[2*s],  b = sub_segments[2*s + 1];
+                if((a == u && b == v) || (a == v && b == u))
+                    return true;
+            }
+            return false;
+        };
+        
+        uint            n_flips     = 0;
+        bool            flipped     = true;
+        while(flipped) {
+            flipped = false;
+            for(uint t=0; t<n_tris; t++) {
+                for(uint k=0; k<3; k++) {
+                    int     a = tris[3*t + k];
+                    int     b = tris[3*t + (k+1) % 3];
+                    int     c = tris[3*t + (k+2) % 3];
+                    if(isSegment(a, b))     continue;
+                    // find the triangle on the other side of a-b
+                    uint    u = 0,  j = 0;
+                    for(; u<n_tris; u++) {
+                        if(u == t)          continue;
+                        for(j=0; j<3; j++)
+                            if(tris[3*u + j] == b &&
+                               tris[3*u + (j+1) % 3] == a)  break;
+                        if(j < 3)           break;
+                    }
+                    if(u == n_tris)
+                        return false;
+                    int     d = tris[3*u + (j+2) % 3];
+                    int     incircle = incircleFilter(xy + 2*a, xy + 2*b,
+                                                      xy + 2*c, xy + 2*d);
+                    if(incircle == 0)
+                        return false;
+                    if(incircle < 0)        continue;
+                    
+                    // the quad a,d,b,c is convex, so this is always ok
+                    if(++n_flips > 4*n_tris*n_tris)
+                        return false;
+                    tris[3*t + 0] = d;  tris[3*t + 1] = b;  tris[3*t + 2] = c;
+                    tris[3*u + 0] = d;  tris[3*u + 1] = c;  tris[3*u + 2] = a;
+                    flipped = true;
+                }
+            }
+        }
+        return true;
+    }
+    
+    void emitSubdivision(IsctProblem *iprob) {
+        ShortVec<GVptr, 7> &points = sub_points;
+        uint n_tris = sub_tris.size() / 3;
+        gtris.resize(n_tris);
+        for(uint k=0; k<n_tris; k++) {
+            GVptr       gv0         = points[sub_tris[(k*3)+0]];
+            GVptr       gv1         = points[sub_tris[(k*3)+1]];
+            GVptr       gv2         = points[sub_tris[(k*3)+2]];
+                        gtris[k]    = iprob->newGenericTri(gv0, gv1, gv2);
+        }
+        
+        // release the scratch space
+        points.resize(0);
+        std::vector<REAL>().swap(sub_coords);
+        std::vector<int>().swap(sub_point_markers);
+        std::vector<int>().swap(sub_segments);
+        std::vector<int>().swap(sub_segment_markers);
+        std::vector<int>().swap(sub_tris);
+    }
+
 private:
     void subdivideEdge(IsctProblem *iprob, GEptr ge, ShortVec<GEptr, 8> &edges)
     {
@@ -606,6 +983,14 @@ public: // data
     ShortVec<GTptr, 8>      gtris;
     
     Tptr                    the_tri;
+    
+private: // scratch space for the subdivision
+    ShortVec<GVptr, 7>      sub_points;
+    std::vector<REAL>       sub_coords;
+    std::vector<int>        sub_point_markers;
+    std::vector<int>        sub_segments;
+    std::vector<int>        sub_segment_markers;
+    std::vector<int>        sub_tris;
 };
 
 
@@ -613,7 +998,13 @@ template<class VertData, class TriData>
 class Mesh<VertData,TriData>::IsctProblem : public TopoCache
 {
 public:
-    IsctProblem(Mesh *owner) : TopoCache(owner)
+    IsctProblem(Mesh *owner, CorkContext *context) :
+        IsctProblem(owner, context, maxMagnitude(owner))
+    {}
+    // the quantization grid may be fit to a larger mesh than the owner,
+    // when the owner was cut out of that mesh
+    IsctProblem(Mesh *owner, CorkContext *context, double maxMag) :
+        TopoCache(owner), ctx(context)
     {
         // initialize all the triangles to NOT have an associated tprob
         TopoCache::tris.for_each([](Tptr t) {
@@ -621,11 +1012,8 @@ public:
         });
         
         // Callibrate the quantization unit...
-        double maxMag = 0.0;
-        for(VertData &v : TopoCache::mesh->verts) {
-            maxMag = std::max(maxMag, max(abs(v.pos)));
-        }
-        Quantization::callibrate(maxMag);
+        Quantization::Quantizer &quant = ctx->arith.quantizer;
+        quant.callibrate(maxMag);
         
         // and use vertex auxiliary data to store quantized vertex coordinates
         uint N = TopoCache::mesh->verts.size();
@@ -637,9 +1025,9 @@ public:
 #else
             Vec3d raw = TopoCache::mesh->verts[v->ref].pos;
 #endif
-            quantized_coords[write].x = Quantization::quantize(raw.x);
-            quantized_coords[write].y = Quantization::quantize(raw.y);
-            quantized_coords[write].z = Quantization::quantize(raw.z);
+            quantized_coords[write].x = quant.quantize(raw.x);
+            quantized_coords[write].y = quant.quantize(raw.y);
+            quantized_coords[write].z = quant.quantize(raw.z);
             v->data = &(quantized_coords[write]);
             write++;
         });
@@ -647,6 +1035,23 @@ public:
     
     virtual ~IsctProblem() {}
     
+    inline CorkContext* context() const { return ctx; }
+    
+    static double maxMagnitude(const Mesh *mesh) {
+        double maxMag = 0.0;
+        for(const VertData &v : mesh->verts) {
+            maxMag = std::max(maxMag, max(abs(v.pos)));
+        }
+        return maxMag;
+    }
+    
+    // Only look for intersections between triangles with different
+    // operand labels (indexed by triangle); use this when each
+    // operand is known to be free of self-intersections
+    inline void onlyCrossOperands(const std::vector<uint> &operands) {
+        tri_operands = operands;
+    }
+    
     // access auxiliary quantized coordinates
     inline Vec3d vPos(Vptr v) const {
         return *(reinterpret_cast<Vec3d*>(v->data));
@@ -666,18 +1071,10 @@ public:
         return glue;
     }
     
-    inline IVptr newIsctVert(Eptr e, Tptr t, GluePt glue) {
-        IVptr       iv                  = ivpool.alloc();
-                    iv->concrete        = nullptr;
-                    iv->coord           = computeCoords(e, t);
-                    iv->glue_marker     = glue;
-                    glue->copies.push_back(iv);
-        return      iv;
-    }
-    inline IVptr newIsctVert(Tptr t0, Tptr t1, Tptr t2, GluePt glue) {
+    // the coordinates are filled in later, by computeGlueCoords()
+    inline IVptr newIsctVert(GluePt glue) {
         IVptr       iv                  = ivpool.alloc();
                     iv->concrete        = nullptr;
-                    iv->coord           = computeCoords(t0, t1, t2);
                     iv->glue_marker     = glue;
                     glue->copies.push_back(iv);
         return      iv;
@@ -687,13 +1084,13 @@ public:
                     iv->concrete        = nullptr;
                     iv->coord           = coords;
                     iv->glue_marker     = glue;
+                    glue->coord         = coords;
                     glue->copies.push_back(iv);
         return      iv;
     }
     inline IVptr copyIsctVert(IVptr orig) {
         IVptr       iv                  = ivpool.alloc();
                     iv->concrete        = nullptr;
-                    iv->coord           = orig->coord;
                     iv->glue_marker     = orig->glue_marker;
                     orig->glue_marker->copies.push_back(iv);
         return      iv;
@@ -809,19 +1206,23 @@ public:
     void findIntersections();
     void resolveAllIntersections();
 private:
-    // if we encounter ambiguous degeneracies, then this
-    // routine returns false, indicating that the computation aborted.
-    bool tryToFindIntersections();
-    // In that case, we can perturb the positions of points
-    void perturbPositions();
-    // in order to give things another try, discard partial work
-    void reset();
+    // move the vertices with the given refs off of any special
+    // positions, and throw away any triangle problems built so far
+    void nudgeVerts(const std::vector<uint> &refs);
+    void clearProblems();
+    // fill in tri_planes and edge_lines from the final positions
+    void computePlanesAndLines();
 public:
     
     void dumpIsctPoints(std::vector<Vec3d> *points);
     void dumpIsctEdges(std::vector< std::pair<Vec3d,Vec3d> > *edges);
+    // the edges marked by resolveAllIntersections, as vertex ids
+    // (call after commit(), so that the ids are final)
+    void dumpIsctEdgeIds(std::vector< std::pair<uint,uint> > *edges);
     
 protected: // DATA
+    CorkContext                 *ctx;
+    
     IterPool<GluePointMarker>   glue_pts;
     IterPool<TriangleProblem>   tprobs;
     
@@ -833,11 +1234,22 @@ protected: // DATA
     IterPool<GenericTriType>    gtpool;
 private:
     std::vector<Vec3d>          quantized_coords;
+    // the float filter's input for each triangle (indexed by ref),
+    // and for each edge (indexed by the edge's index)
+    std::vector<Empty3d::TriPlane>  tri_planes;
+    std::vector<Empty3d::EdgeLine>  edge_lines;
+    std::vector<uint>           tri_operands; // empty if not restricted
 private:
     inline void for_edge_tri(std::function<bool(Eptr e, Tptr t)>);
     inline void bvh_edge_tri(std::function<bool(Eptr e, Tptr t)>);
+    inline void bvh_cross_edge_tri(std::function<bool(Eptr e, Tptr t)>);
+
+    inline bool overlap_edge_tri(const AABVH<Eptr> &edgeBVH,
+                                 const AABVH<Tptr> &triBVH,
+                                 std::function<bool(Eptr e, Tptr t)> &func);
 
     inline GeomBlob<Eptr> edge_blob(Eptr e);
+    inline GeomBlob<Tptr> tri_blob(Tptr t);
     inline BBox3d bboxFromTptr(Tptr t);
     
     inline BBox3d buildBox(Eptr e) const;
@@ -850,11 +1262,15 @@ private:
     inline void marshallArithmeticInput(
         Empty3d::TriTriTriIn &input, Tptr t0, Tptr t1, Tptr t2) const;
     
+    bool mayIsct(Eptr e, Tptr t) const;
     bool checkIsct(Eptr e, Tptr t) const;
+    void checkIscts(const std::vector< std::pair<Eptr,Tptr> > &candidates,
+                    std::vector<byte> &hits) const;
     bool checkIsct(Tptr t0, Tptr t1, Tptr t2) const;
     
-    Vec3d computeCoords(Eptr e, Tptr t) const;
-    Vec3d computeCoords(Tptr t0, Tptr t1, Tptr t2) const;
+    Vec3d computeCoords(Empty3d::ExactArithmeticContext *arith,
+                        GluePt glue) const;
+    void computeGlueCoords();
     
     void fillOutVertData(GluePt glue, VertData &data);
     void fillOutTriData(Tptr tri, Tptr parent);
@@ -866,6 +1282,11 @@ private: // functions here to get around a GCC bug...
     void createRealTriangles(Tprob tprob, EdgeCache &ecache);
 };
 
+// how far nudgeVerts() may move a vertex along each axis,
+// and how many times findIntersections() will try it
+static const double PERTURB_EPSILON = 1.0e-5;
+static const uint   NUDGE_ROUNDS    = 3;
+
 template<class T, uint LEN> inline
 void for_pairs(
     ShortVec<T,LEN> &vec,
@@ -910,166 +1331,293 @@ GeomBlob<Eptr> Mesh<VertData,TriData>::IsctProblem::edge_blob(
     return blob;
 }
 
+template<class VertData, class TriData> inline
+GeomBlob<Tptr> Mesh<VertData,TriData>::IsctProblem::tri_blob(
+    Tptr t
+) {
+    GeomBlob<Tptr>  blob;
+    blob.bbox = buildBox(t);
+    blob.point = (blob.bbox.minp + blob.bbox.maxp) / 2.0;
+    blob.id = t;
+    return blob;
+}
+
+// number of candidate pairs handed over at a time
+static const uint EDGE_TRI_BATCH = 1024;
+
+// walk an edge and a triangle hierarchy together, and test the
+// candidate pairs they turn up; false if func stopped the search
+template<class VertData, class TriData> inline
+bool Mesh<VertData,TriData>::IsctProblem::overlap_edge_tri(
+    const AABVH<Eptr> &edgeBVH, const AABVH<Tptr> &triBVH,
+    std::function<bool(Eptr e, Tptr t)> &func
+) {
+    bool aborted = false;
+    uint candidates = 0;
+    uint visits = edgeBVH.for_each_overlap(triBVH, EDGE_TRI_BATCH,
+        [&](const std::vector< std::pair<Eptr,Tptr> > &batch) -> bool {
+            candidates += batch.size();
+            for(const std::pair<Eptr,Tptr> &et : batch) {
+                if(!func(et.first, et.second)) {
+                    aborted = true;
+                    break;
+                }
+            }
+            return !aborted;
+        });
+    ctx->bvh.visits     += visits;
+    ctx->bvh.candidates += candidates;
+    return !aborted;
+}
+
 template<class VertData, class TriData> inline
 void Mesh<VertData,TriData>::IsctProblem::bvh_edge_tri(
     std::function<bool(Eptr e, Tptr t)> func
 ) {
+    if(!tri_operands.empty()) {
+        bvh_cross_edge_tri(func);
+        return;
+    }
+    
     std::vector< GeomBlob<Eptr> > edge_geoms;
     TopoCache::edges.for_each([&](Eptr e) {
         edge_geoms.push_back(edge_blob(e));
     });
-    AABVH<Eptr> edgeBVH(edge_geoms);
+    std::vector< GeomBlob<Tptr> > tri_geoms;
+    TopoCache::tris.for_each([&](Tptr t) {
+        tri_geoms.push_back(tri_blob(t));
+    });
+    AABVH<Eptr> edgeBVH(edge_geoms, ctx->n_threads, &ctx->bvh);
+    AABVH<Tptr> triBVH(tri_geoms, ctx->n_threads, &ctx->bvh);
     
-    // use the acceleration structure
-    bool aborted = false;
+    overlap_edge_tri(edgeBVH, triBVH, func);
+}
+
+// same, but with hierarchies per operand, so that triangles
+// are only ever tested against the edges of other operands
+template<class VertData, class TriData> inline
+void Mesh<VertData,TriData>::IsctProblem::bvh_cross_edge_tri(
+    std::function<bool(Eptr e, Tptr t)> func
+) {
+    uint n_operands = 0;
+    for(uint op : tri_operands)
+        n_operands = std::max(n_operands, op + 1);
+    
+    // every triangle on an edge comes from the same operand
+    std::vector< std::vector< GeomBlob<Eptr> > > edge_geoms(n_operands);
+    TopoCache::edges.for_each([&](Eptr e) {
+        uint op = tri_operands[e->tris[0]->ref];
+        edge_geoms[op].push_back(edge_blob(e));
+    });
+    std::vector< std::vector< GeomBlob<Tptr> > > tri_geoms(n_operands);
     TopoCache::tris.for_each([&](Tptr t) {
-        // compute BBox
-        BBox3d bbox = buildBox(t);
-        if(!aborted) {
-            edgeBVH.for_each_in_box(bbox, [&](Eptr e) {
-                if(!func(e,t))
-                    aborted = true;
-            });
-        }
+        tri_geoms[tri_operands[t->ref]].push_back(tri_blob(t));
     });
+    std::vector< AABVH<Eptr>* > edgeBVHs(n_operands, nullptr);
+    std::vector< AABVH<Tptr>* > triBVHs(n_operands, nullptr);
+    for(uint op=0; op<n_operands; op++) {
+        if(edge_geoms[op].size() > 0)
+            edgeBVHs[op] = new AABVH<Eptr>(edge_geoms[op],
+                                           ctx->n_threads, &ctx->bvh);
+        if(tri_geoms[op].size() > 0)
+            triBVHs[op] = new AABVH<Tptr>(tri_geoms[op],
+                                          ctx->n_threads, &ctx->bvh);
+    }
+    
+    bool aborted = false;
+    for(uint t_op=0; t_op<n_operands && !aborted; t_op++) {
+        for(uint e_op=0; e_op<n_operands && !aborted; e_op++) {
+            if(e_op == t_op || !edgeBVHs[e_op] || !triBVHs[t_op])  continue;
+            aborted = !overlap_edge_tri(*edgeBVHs[e_op], *triBVHs[t_op],
+                                        func);
+        }
+    }
+    
+    for(AABVH<Eptr> *bvh : edgeBVHs)
+        delete bvh;
+    for(AABVH<Tptr> *bvh : triBVHs)
+        delete bvh;
 }
 
 template<class VertData, class TriData>
-bool Mesh<VertData,TriData>::IsctProblem::tryToFindIntersections()
+void Mesh<VertData,TriData>::IsctProblem::findIntersections()
 {
-    Empty3d::degeneracy_count = 0;
-    // Find all edge-triangle intersection points
-    //for_edge_tri([&](Eptr eisct, Tptr tisct)->bool{
-    bvh_edge_tri([&](Eptr eisct, Tptr tisct)->bool{
-      if(checkIsct(eisct,tisct)) {
-        GluePt      glue                    = newGluePt();
-                    glue->edge_tri_type     = true;
-                    glue->e                 = eisct;
-                    glue->t[0]              = tisct;
-        // first add point and edges to the pierced triangle
-        IVptr iv = getTprob(tisct)->addInteriorEndpoint(this, eisct, glue);
-        for(Tptr tri : eisct->tris) {
-            getTprob(tri)->addBoundaryEndpoint(this, tisct, eisct, iv);
+    // Degeneracies are decided by the symbolic perturbation in the exact
+    // tests.  That settles which intersections there are, but the new
+    // points are placed where the perturbed ones converge to, so with
+    // degenerate input they can land on each other or on the original
+    // vertices, and the triangle problems (Triangle and clipEars) can't
+    // take repeated points.  So when any test needed the perturbation,
+    // the vertices it was about get nudged and we start over.  Input
+    // without degeneracies is never moved.
+    for(uint round=0; ; round++) {
+        bool last_round = (round == NUDGE_ROUNDS);
+        ctx->arith.degenerate_ids.clear();
+        computePlanesAndLines();
+        
+        // Find all edge-triangle intersection points.
+        // The exact tests are independent of each other, so they all
+        // run (in parallel) before any of the triangle problems are
+        // touched, which then happens in candidate order
+        std::vector< std::pair<Eptr,Tptr> > candidates;
+        bvh_edge_tri([&](Eptr eisct, Tptr tisct)->bool{
+            candidates.push_back(std::make_pair(eisct, tisct));
+            return true; // continue
+        });
+        std::vector<byte> hits;
+        checkIscts(candidates, hits);
+        if(!last_round && ctx->arith.degenerate_ids.size() > 0) {
+            nudgeVerts(ctx->arith.degenerate_ids);
+            continue;
         }
-      }
-      if(Empty3d::degeneracy_count > 0)
-        return false; // break
-      else
-        return true; // continue
-    });
-    if(Empty3d::degeneracy_count > 0) {
-        return false;   // restart / abort
-    }
-    
-    // we're going to peek into the triangle problems in order to
-    // identify potential candidates for Tri-Tri-Tri intersections
-    std::vector<TriTripleTemp> triples;
-    tprobs.for_each([&](Tprob tprob) {
-        Tptr t0 = tprob->the_tri;
-        // Scan pairs of existing edges to create candidate triples
-        for_pairs<IEptr,2>(tprob->iedges, [&](IEptr &ie1, IEptr &ie2){
-            Tptr t1 = ie1->other_tri_key;
-            Tptr t2 = ie2->other_tri_key;
-            // This triple might be considered three times,
-            // one for each triangle it contains.
-            // To prevent duplication, only proceed if this is
-            // the least triangle according to an arbitrary ordering
-            if(t0 < t1 && t0 < t2) {
-                // now look for the third edge.  We're not
-                // sure if it exists...
-                Tprob prob1 = reinterpret_cast<Tprob>(t1->data);
-                for(IEptr ie : prob1->iedges) {
-                    if(ie->other_tri_key == t2) {
-                        // ADD THE TRIPLE
-                        triples.push_back(TriTripleTemp(t0, t1, t2));
+        
+        for(uint i=0; i<candidates.size(); i++) {
+            if(!hits[i])    continue;
+            Eptr    eisct               = candidates[i].first;
+            Tptr    tisct               = candidates[i].second;
+            GluePt  glue                = newGluePt();
+                    glue->edge_tri_type = true;
+                    glue->e             = eisct;
+                    glue->t[0]          = tisct;
+            // first add point and edges to the pierced triangle
+            IVptr iv = getTprob(tisct)->addInteriorEndpoint(this, eisct,
+                                                            glue);
+            for(Tptr tri : eisct->tris) {
+                getTprob(tri)->addBoundaryEndpoint(this, tisct, eisct, iv);
+            }
+        }
+        
+        // we're going to peek into the triangle problems in order to
+        // identify potential candidates for Tri-Tri-Tri intersections
+        std::vector<TriTripleTemp> triples;
+        tprobs.for_each([&](Tprob tprob) {
+            Tptr t0 = tprob->the_tri;
+            // Scan pairs of existing edges to create candidate triples
+            for_pairs<IEptr,2>(tprob->iedges, [&](IEptr &ie1, IEptr &ie2){
+                Tptr t1 = ie1->other_tri_key;
+                Tptr t2 = ie2->other_tri_key;
+                // This triple might be considered three times,
+                // one for each triangle it contains.
+                // To prevent duplication, only proceed if this is
+                // the least triangle according to an arbitrary ordering
+                if(t0 < t1 && t0 < t2) {
+                    // now look for the third edge.  We're not
+                    // sure if it exists...
+                    Tprob prob1 = reinterpret_cast<Tprob>(t1->data);
+                    for(IEptr ie : prob1->iedges) {
+                        if(ie->other_tri_key == t2) {
+                            // ADD THE TRIPLE
+                            triples.push_back(TriTripleTemp(t0, t1, t2));
+                        }
                     }
                 }
-            }
+            });
         });
-    });
-    // Now, we've collected a list of Tri-Tri-Tri intersection candidates.
-    // Check to see if the intersections actually exist.
-    for(TriTripleTemp t : triples) {
-        if(!checkIsct(t.t0, t.t1, t.t2))    continue;
-        
-        // Abort if we encounter a degeneracy
-        if(Empty3d::degeneracy_count > 0)   break;
+        // Now, we've collected a list of Tri-Tri-Tri intersection
+        // candidates.  Check to see if the intersections actually exist.
+        std::vector<TriTripleTemp> hit_triples;
+        for(TriTripleTemp t : triples) {
+            if(checkIsct(t.t0, t.t1, t.t2))
+                hit_triples.push_back(t);
+        }
+        if(!last_round && ctx->arith.degenerate_ids.size() > 0) {
+            clearProblems();
+            nudgeVerts(ctx->arith.degenerate_ids);
+            continue;
+        }
         
-        GluePt      glue                    = newGluePt();
-                    glue->edge_tri_type     = false;
-                    glue->t[0]              = t.t0;
-                    glue->t[1]              = t.t1;
-                    glue->t[2]              = t.t2;
-        getTprob(t.t0)->addInteriorPoint(this, t.t1, t.t2, glue);
-        getTprob(t.t1)->addInteriorPoint(this, t.t0, t.t2, glue);
-        getTprob(t.t2)->addInteriorPoint(this, t.t0, t.t1, glue);
-    }
-    if(Empty3d::degeneracy_count > 0) {
-        return false;   // restart / abort
+        for(TriTripleTemp t : hit_triples) {
+            GluePt  glue                = newGluePt();
+                    glue->edge_tri_type = false;
+                    glue->t[0]          = t.t0;
+                    glue->t[1]          = t.t1;
+                    glue->t[2]          = t.t2;
+            getTprob(t.t0)->addInteriorPoint(this, t.t1, t.t2, glue);
+            getTprob(t.t1)->addInteriorPoint(this, t.t0, t.t2, glue);
+            getTprob(t.t2)->addInteriorPoint(this, t.t0, t.t1, glue);
+        }
+        break;
     }
     
-    return true;
+    computeGlueCoords();
+    
+    // ok all points put together,
+    // all triangle problems assembled.
+    // Some intersection edges may have original vertices as endpoints
+    // we consolidate the problems to check for cases like these.
+    tprobs.for_each([&](Tprob tprob) {
+        tprob->consolidate(this);
+    });
 }
 
+// Each vertex is moved from its quantized position by an offset which
+// only depends on the vertex and the context's random source, and is
+// drawn again each time.  So a vertex is never more than
+// PERTURB_EPSILON away from its real position along any axis.
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::IsctProblem::perturbPositions()
-{
-    const double EPSILON = 1.0e-5; // perturbation epsilon
-    for(Vec3d &coord : quantized_coords) {
-        Vec3d perturbation(Quantization::quantize(drand(-EPSILON, EPSILON)),
-                           Quantization::quantize(drand(-EPSILON, EPSILON)),
-                           Quantization::quantize(drand(-EPSILON, EPSILON)));
-        coord += perturbation;
-    }
+void Mesh<VertData,TriData>::IsctProblem::nudgeVerts(
+    const std::vector<uint> &refs
+) {
+    std::vector<bool> nudge(TopoCache::mesh->verts.size(), false);
+    for(uint ref : refs)
+        nudge[ref] = true;
+    
+    const double EPSILON = PERTURB_EPSILON;
+    const Quantization::Quantizer &quant = ctx->arith.quantizer;
+    unsigned long long seed = ctx->random.next();
+    TopoCache::verts.for_each([&](Vptr v) {
+        if(!nudge[v->ref])  return;
+        RandomStream rand(seed ^
+                          (0x9E3779B97F4A7C15ULL * (v->ref + 1ULL)));
+        Vec3d raw = TopoCache::mesh->verts[v->ref].pos;
+        Vec3d perturbation(quant.quantize(rand.drand(-EPSILON, EPSILON)),
+                           quant.quantize(rand.drand(-EPSILON, EPSILON)),
+                           quant.quantize(rand.drand(-EPSILON, EPSILON)));
+        Vec3d &pos = *(reinterpret_cast<Vec3d*>(v->data));
+        pos.x = quant.quantize(raw.x) + perturbation.x;
+        pos.y = quant.quantize(raw.y) + perturbation.y;
+        pos.z = quant.quantize(raw.z) + perturbation.z;
+    });
 }
 
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::IsctProblem::reset()
+void Mesh<VertData,TriData>::IsctProblem::clearProblems()
 {
-    // the data pointer in the triangles points to tproblems
-    // that we're about to destroy,
-    // so zero out all those pointers first!
-    tprobs.for_each([](Tprob tprob) {
-        Tptr t = tprob->the_tri;
-        t->data = nullptr;
-    });
-    
-    glue_pts.clear();
     tprobs.clear();
-    
+    glue_pts.clear();
     ivpool.clear();
     ovpool.clear();
     iepool.clear();
     oepool.clear();
     sepool.clear();
     gtpool.clear();
+    TopoCache::tris.for_each([](Tptr t) {
+        t->data = nullptr;
+    });
 }
 
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::IsctProblem::findIntersections()
+void Mesh<VertData,TriData>::IsctProblem::computePlanesAndLines()
 {
-    int nTrys = 5;
-    perturbPositions(); // always perturb for safety...
-    while(nTrys > 0) {
-        if(!tryToFindIntersections()) {
-            reset();
-            perturbPositions();
-            nTrys--;
-        } else {
-            break;
-        }
-    }
-    if(nTrys <= 0) {
-        CORK_ERROR("Ran out of tries to perturb the mesh");
-        exit(1);
-    }
+    tri_planes.resize(TopoCache::mesh->tris.size());
+    TopoCache::tris.for_each([&](Tptr t) {
+        Empty3d::TriIn input;
+        marshallArithmeticInput(input, t);
+        Empty3d::triPlane(tri_planes[t->ref], input);
+    });
     
-    // ok all points put together,
-    // all triangle problems assembled.
-    // Some intersection edges may have original vertices as endpoints
-    // we consolidate the problems to check for cases like these.
-    tprobs.for_each([&](Tprob tprob) {
-        tprob->consolidate(this);
+    uint n_edges = 0;
+    TopoCache::edges.for_each([&](Eptr) {
+        n_edges++;
+    });
+    edge_lines.resize(n_edges);
+    uint write = 0;
+    TopoCache::edges.for_each([&](Eptr e) {
+        Empty3d::EdgeIn input;
+        marshallArithmeticInput(input, e);
+        Empty3d::edgeLine(edge_lines[write], input);
+        e->index = write;
+        write++;
     });
 }
 
@@ -1077,26 +1625,16 @@ template<class VertData, class TriData>
 bool Mesh<VertData,TriData>::IsctProblem::hasIntersections()
 {
     bool foundIsct = false;
-    Empty3d::degeneracy_count = 0;
     // Find some edge-triangle intersection point...
     bvh_edge_tri([&](Eptr eisct, Tptr tisct)->bool{
       if(checkIsct(eisct,tisct)) {
         foundIsct = true;
         return false; // break;
       }
-      if(Empty3d::degeneracy_count > 0) {
-        return false; // break;
-      }
       return true; // continue
     });
     
-    if(Empty3d::degeneracy_count > 0 || foundIsct) {
-        std::cout << "This self-intersection might be spurious. "
-                     "Degeneracies were detected." << std::endl;
-        return true;
-    } else {
-        return false;
-    }
+    return foundIsct;
 }
 
 
@@ -1122,6 +1660,8 @@ void Mesh<VertData,TriData>::IsctProblem::marshallArithmeticInput(
 ) const {
     input.p[0] = vPos(e->verts[0]);
     input.p[1] = vPos(e->verts[1]);
+    input.id[0] = e->verts[0]->ref;
+    input.id[1] = e->verts[1]->ref;
 }
 template<class VertData, class TriData> inline
 void Mesh<VertData,TriData>::IsctProblem::marshallArithmeticInput(
@@ -1130,6 +1670,9 @@ void Mesh<VertData,TriData>::IsctProblem::marshallArithmeticInput(
     input.p[0] = vPos(t->verts[0]);
     input.p[1] = vPos(t->verts[1]);
     input.p[2] = vPos(t->verts[2]);
+    input.id[0] = t->verts[0]->ref;
+    input.id[1] = t->verts[1]->ref;
+    input.id[2] = t->verts[2]->ref;
 }
 template<class VertData, class TriData> inline
 void Mesh<VertData,TriData>::IsctProblem::marshallArithmeticInput(
@@ -1151,6 +1694,78 @@ void Mesh<VertData,TriData>::IsctProblem::marshallArithmeticInput(
 
 template<class VertData, class TriData>
 bool Mesh<VertData,TriData>::IsctProblem::checkIsct(Eptr e, Tptr t) const
+{
+    if(!mayIsct(e, t))
+                return      false;
+    
+    Empty3d::TriEdgeIn input;
+    marshallArithmeticInput(input, e, t);
+    //bool empty = Empty3d::isEmpty(input);
+    bool empty = Empty3d::emptyExact(&ctx->arith, input);
+    return !empty;
+}
+
+// Test a whole list of candidates, setting hits[i] for the pairs that
+// intersect.  The exact tests run a batch at a time (see
+// Empty3d::TriEdgeBatch).  Each thread counts its predicate calls in
+// its own arithmetic context; the counts are added to ours at the end.
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::IsctProblem::checkIscts(
+    const std::vector< std::pair<Eptr,Tptr> > &candidates,
+    std::vector<byte> &hits
+) const {
+    hits.assign(candidates.size(), 0);
+    
+    uint n_threads = (ctx->n_threads > 0)?  ctx->n_threads :
+                                            defaultThreadCount();
+    std::vector<Empty3d::ExactArithmeticContext> ariths(n_threads);
+    for(Empty3d::ExactArithmeticContext &arith : ariths)
+        arith.quantizer = ctx->arith.quantizer;
+    // scratch space for each thread
+    struct Scratch {
+        Empty3d::TriEdgeBatch   batch;
+        std::vector<uint>       which; // candidate of each batch entry
+        std::vector<byte>       empty;
+    };
+    std::vector<Scratch> scratch(n_threads);
+    
+    uint n_chunks = (candidates.size() + EDGE_TRI_BATCH - 1) / EDGE_TRI_BATCH;
+    parallelFor(n_chunks, n_threads, [&](uint c, uint thread) {
+        uint begin  = c * EDGE_TRI_BATCH;
+        uint end    = std::min(begin + EDGE_TRI_BATCH,
+                               uint(candidates.size()));
+        Scratch &tmp = scratch[thread];
+        tmp.batch.clear();
+        tmp.which.clear();
+        for(uint i=begin; i<end; i++) {
+            Eptr e = candidates[i].first;
+            Tptr t = candidates[i].second;
+            if(!mayIsct(e, t))  continue;
+            Empty3d::TriEdgeIn input;
+            marshallArithmeticInput(input, e, t);
+            tmp.batch.push_back(input, tri_planes[t->ref],
+                                edge_lines[e->index]);
+            tmp.which.push_back(i);
+        }
+        tmp.empty.resize(tmp.batch.size());
+        Empty3d::emptyExact(&ariths[thread], tmp.batch, tmp.empty.data());
+        for(uint k=0; k<tmp.which.size(); k++)
+            hits[tmp.which[k]] = !tmp.empty[k];
+    });
+    
+    for(const Empty3d::ExactArithmeticContext &arith : ariths) {
+        ctx->arith.callcount        += arith.callcount;
+        ctx->arith.exact_count      += arith.exact_count;
+        ctx->arith.degeneracy_count += arith.degeneracy_count;
+        ctx->arith.degenerate_ids.insert(ctx->arith.degenerate_ids.end(),
+                                         arith.degenerate_ids.begin(),
+                                         arith.degenerate_ids.end());
+    }
+}
+
+// the cheap tests, which rule out most candidates
+template<class VertData, class TriData>
+bool Mesh<VertData,TriData>::IsctProblem::mayIsct(Eptr e, Tptr t) const
 {
     // simple bounding box cull; for acceleration, not correctness
     BBox3d      ebox        = buildBox(e);
@@ -1164,11 +1779,7 @@ bool Mesh<VertData,TriData>::IsctProblem::checkIsct(Eptr e, Tptr t) const
     if(hasCommonVert(e, t))
                 return      false;
     
-    Empty3d::TriEdgeIn input;
-    marshallArithmeticInput(input, e, t);
-    //bool empty = Empty3d::isEmpty(input);
-    bool empty = Empty3d::emptyExact(input);
-    return !empty;
+    return true;
 }
 
 template<class VertData, class TriData>
@@ -1197,27 +1808,53 @@ bool Mesh<VertData,TriData>::IsctProblem::checkIsct(
     Empty3d::TriTriTriIn input;
     marshallArithmeticInput(input, t0, t1, t2);
     //bool empty = Empty3d::isEmpty(input);
-    bool empty = Empty3d::emptyExact(input);
+    bool empty = Empty3d::emptyExact(&ctx->arith, input);
     return !empty;
 }
 
 template<class VertData, class TriData>
-Vec3d Mesh<VertData,TriData>::IsctProblem::computeCoords(Eptr e, Tptr t) const
-{
-    Empty3d::TriEdgeIn input;
-    marshallArithmeticInput(input, e, t);
-    Vec3d coords = Empty3d::coordsExact(input);
-    return coords;
+Vec3d Mesh<VertData,TriData>::IsctProblem::computeCoords(
+    Empty3d::ExactArithmeticContext *arith, GluePt glue
+) const {
+    if(glue->edge_tri_type) {
+        Empty3d::TriEdgeIn input;
+        marshallArithmeticInput(input, glue->e, glue->t[0]);
+        return Empty3d::coordsExact(arith, input);
+    } else {
+        Empty3d::TriTriTriIn input;
+        marshallArithmeticInput(input, glue->t[0], glue->t[1], glue->t[2]);
+        return Empty3d::coordsExact(arith, input);
+    }
 }
 
+// Every glue point has one copy of its vertex per triangle it's in,
+// but only needs its coordinates computed once.  That is left until
+// all the glue points are known, and then done for all of them at
+// once (in parallel)
 template<class VertData, class TriData>
-Vec3d Mesh<VertData,TriData>::IsctProblem::computeCoords(
-    Tptr t0, Tptr t1, Tptr t2
-) const {
-    Empty3d::TriTriTriIn input;
-    marshallArithmeticInput(input, t0, t1, t2);
-    Vec3d coords = Empty3d::coordsExact(input);
-    return coords;
+void Mesh<VertData,TriData>::IsctProblem::computeGlueCoords()
+{
+    std::vector<GluePt> glues;
+    glue_pts.for_each([&](GluePt glue) {
+        if(!glue->split_type)
+            glues.push_back(glue);
+    });
+    
+    uint n_threads = (ctx->n_threads > 0)?  ctx->n_threads :
+                                            defaultThreadCount();
+    std::vector<Empty3d::ExactArithmeticContext> ariths(n_threads);
+    for(Empty3d::ExactArithmeticContext &arith : ariths)
+        arith.quantizer = ctx->arith.quantizer;
+    parallelFor(glues.size(), n_threads, [&](uint i, uint thread) {
+        glues[i]->coord = computeCoords(&ariths[thread], glues[i]);
+    }, 64);
+    for(const Empty3d::ExactArithmeticContext &arith : ariths)
+        ctx->arith.degeneracy_count += arith.degeneracy_count;
+    
+    for(GluePt glue : glues) {
+        for(IVptr iv : glue->copies)
+            iv->coord = glue->coord;
+    }
 }
 
 
@@ -1398,9 +2035,17 @@ template<class VertData, class TriData>
 void Mesh<VertData,TriData>::IsctProblem::resolveAllIntersections()
 {
     // solve a subdivision problem in each triangle
+    // (the triangulations are independent, so they run in parallel)
+    std::vector<Tprob> problems;
     tprobs.for_each([&](Tprob tprob) {
-        tprob->subdivide(this);
+        tprob->prepareSubdivision(this);
+        problems.push_back(tprob);
     });
+    parallelFor(problems.size(), ctx->n_threads, [&](uint i, uint) {
+        problems[i]->solveSubdivision();
+    }, 16);
+    for(Tprob tprob : problems)
+        tprob->emitSubdivision(this);
     
     // now we have diced up triangles inside each triangle problem
     
@@ -1474,11 +2119,24 @@ void Mesh<VertData,TriData>::IsctProblem::dumpIsctEdges(
     });
 }
 
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::IsctProblem::dumpIsctEdgeIds(
+    std::vector< std::pair<uint,uint> > *edges
+) {
+    edges->clear();
+    TopoCache::edges.for_each([&](Eptr e) {
+        if(e->data)
+            edges->push_back(std::make_pair(e->verts[0]->ref,
+                                            e->verts[1]->ref));
+    });
+}
+
 template<class VertData, class TriData>
 void Mesh<VertData,TriData>::testingComputeStaticIsctPoints(
+    CorkContext *ctx,
     std::vector<Vec3d> *points
 ) {
-    IsctProblem iproblem(this);
+    IsctProblem iproblem(this, ctx);
     
     iproblem.findIntersections();
     
@@ -1488,10 +2146,11 @@ void Mesh<VertData,TriData>::testingComputeStaticIsctPoints(
 
 template<class VertData, class TriData>
 void Mesh<VertData,TriData>::testingComputeStaticIsct(
+    CorkContext *ctx,
     std::vector<Vec3d> *points,
     std::vector< std::pair<Vec3d,Vec3d> > *edges
 ) {
-    IsctProblem iproblem(this);
+    IsctProblem iproblem(this, ctx);
     
     iproblem.findIntersections();
     
@@ -1500,9 +2159,11 @@ void Mesh<VertData,TriData>::testingComputeStaticIsct(
 }
 
 template<class VertData, class TriData>
-void Mesh<VertData,TriData>::resolveIntersections()
-{
-    IsctProblem iproblem(this);
+void Mesh<VertData,TriData>::resolveIntersections(
+    CorkContext *ctx,
+    std::vector< std::pair<uint,uint> > *isct_edges
+) {
+    IsctProblem iproblem(this, ctx);
     
     iproblem.findIntersections();
     
@@ -1510,13 +2171,184 @@ void Mesh<VertData,TriData>::resolveIntersections()
     
     iproblem.commit();
     
+    if(isct_edges)
+        iproblem.dumpIsctEdgeIds(isct_edges);
+    
     //iproblem.print();
 }
 
 template<class VertData, class TriData>
-bool Mesh<VertData,TriData>::isSelfIntersecting()
+uint Mesh<VertData,TriData>::findOverlapTris(
+    CorkContext *ctx,
+    const std::vector<uint> &operands,
+    double pad,
+    std::vector<bool> *overlaps
+) const {
+    uint n_operands = 0;
+    for(uint op : operands)
+        n_operands = std::max(n_operands, op + 1);
+    
+    std::vector<BBox3d> boxes(tris.size());
+    std::vector<BBox3d> op_boxes(n_operands);
+    Vec3d padding(pad, pad, pad);
+    for(uint i=0; i<tris.size(); i++) {
+        const Vec3d &p0 = verts[tris[i].a].pos;
+        const Vec3d &p1 = verts[tris[i].b].pos;
+        const Vec3d &p2 = verts[tris[i].c].pos;
+        boxes[i] = BBox3d(min(p0, min(p1, p2)) - padding,
+                          max(p0, max(p1, p2)) + padding);
+        op_boxes[operands[i]] = convex(op_boxes[operands[i]], boxes[i]);
+    }
+    
+    // Cheap cull first: a triangle has to at least touch the
+    // bounding box of another operand.
+    std::vector<bool> near(tris.size(), false);
+    std::vector< std::vector< GeomBlob<uint> > > geoms(n_operands);
+    for(uint i=0; i<tris.size(); i++) {
+        uint op = operands[i];
+        for(uint other=0; other<n_operands; other++) {
+            if(other == op)                                 continue;
+            if(!hasIsct(boxes[i], op_boxes[other]))         continue;
+            near[i] = true;
+            break;
+        }
+        if(near[i]) {
+            GeomBlob<uint> blob;
+            blob.bbox   = boxes[i];
+            blob.point  = (blob.bbox.minp + blob.bbox.maxp) / 2.0;
+            blob.id     = i;
+            geoms[op].push_back(blob);
+        }
+    }
+    std::vector< AABVH<uint>* > bvhs(n_operands, nullptr);
+    for(uint op=0; op<n_operands; op++) {
+        if(geoms[op].size() > 0)
+            bvhs[op] = new AABVH<uint>(geoms[op], ctx->n_threads, &ctx->bvh,
+                                       ctx->bvh_width);
+    }
+    
+    // then check against the triangles of the other operands
+    overlaps->assign(tris.size(), false);
+    uint count = 0;
+    for(uint i=0; i<tris.size(); i++) {
+        if(!near[i])    continue;
+        uint op = operands[i];
+        for(uint other=0; other<n_operands; other++) {
+            if(other == op || !bvhs[other] || (*overlaps)[i])   continue;
+            bvhs[other]->for_each_in_box(boxes[i], [&](uint) {
+                (*overlaps)[i] = true;
+            });
+        }
+        if((*overlaps)[i])  count++;
+    }
+    
+    for(AABVH<uint> *bvh : bvhs)
+        delete bvh;
+    return count;
+}
+
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::resolveIntersections(
+    CorkContext *ctx,
+    const std::vector<uint> &operands,
+    std::vector< std::pair<uint,uint> > *isct_edges
+) {
+    // Any intersection involves triangles whose boxes overlap, and
+    // the triangles on both sides of any edge that pierces a triangle
+    // overlap it.  So only the overlapping triangles are affected, and
+    // the edges between them and the rest of the mesh are never split.
+    // We can cut the overlapping triangles out, resolve them on their
+    // own and splice the result back in.
+    // (quantization and perturbation can move things a little)
+    double maxMag = IsctProblem::maxMagnitude(this);
+    Quantization::Quantizer grid;
+    grid.callibrate(maxMag);
+    double pad = 2.0 * (PERTURB_EPSILON + grid.RESHRINK);
+    
+    std::vector<bool> overlaps;
+    uint n_overlap = findOverlapTris(ctx, operands, pad, &overlaps);
+    
+    // not worth the bookkeeping
+    if(n_overlap * 2 > tris.size()) {
+        IsctProblem iproblem(this, ctx);
+        iproblem.onlyCrossOperands(operands);
+        
+        iproblem.findIntersections();
+        
+        iproblem.resolveAllIntersections();
+        
+        iproblem.commit();
+        
+        if(isct_edges)
+            iproblem.dumpIsctEdgeIds(isct_edges);
+        return;
+    }
+    
+    // cut out the overlapping triangles...
+    Mesh                sub;
+    std::vector<uint>   sub_operands;
+    std::vector<uint>   vmap(verts.size(), INVALID_ID);
+    std::vector<uint>   sub2full;
+    std::vector<Tri>    rest;
+    for(uint i=0; i<tris.size(); i++) {
+        if(!overlaps[i]) {
+            rest.push_back(tris[i]);
+            continue;
+        }
+        Tri tri = tris[i];
+        for(uint k=0; k<3; k++) {
+            uint vid = tri.v[k];
+            if(vmap[vid] == INVALID_ID) {
+                vmap[vid] = sub.verts.size();
+                sub.verts.push_back(verts[vid]);
+                sub2full.push_back(vid);
+            }
+            tri.v[k] = vmap[vid];
+        }
+        sub.tris.push_back(tri);
+        sub_operands.push_back(operands[i]);
+    }
+    uint n_sub_verts = sub.verts.size();
+    
+    // ...resolve them...
+    std::vector< std::pair<uint,uint> > sub_isct_edges;
+    if(sub.tris.size() > 0) {
+        IsctProblem iproblem(&sub, ctx, maxMag);
+        iproblem.onlyCrossOperands(sub_operands);
+        
+        iproblem.findIntersections();
+        
+        iproblem.resolveAllIntersections();
+        
+        iproblem.commit();
+        
+        iproblem.dumpIsctEdgeIds(&sub_isct_edges);
+    }
+    
+    // ...and splice them back in.
+    // (the cut out vertices are all still in use, and keep their order)
+    for(uint k=n_sub_verts; k<sub.verts.size(); k++) {
+        sub2full.push_back(verts.size());
+        verts.push_back(sub.verts[k]);
+    }
+    tris = std::move(rest);
+    for(Tri &tri : sub.tris) {
+        for(uint k=0; k<3; k++)
+            tri.v[k] = sub2full[tri.v[k]];
+        tris.push_back(tri);
+    }
+    if(isct_edges) {
+        isct_edges->clear();
+        for(const auto &e : sub_isct_edges)
+            isct_edges->push_back(std::make_pair(sub2full[e.first],
+                                                 sub2full[e.second]));
+    }
+}
+
+template<class VertData, class TriData>
+bool Mesh<VertData,TriData>::isSelfIntersecting(CorkContext *ctx)
 {
-    IsctProblem iproblem(this);
+    IsctProblem iproblem(this, ctx);
     
     return iproblem.hasIntersections();
 }
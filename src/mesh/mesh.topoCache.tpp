@@ -51,6 +51,7 @@ struct TopoVert {
 
 struct TopoEdge {
     void*                   data;       // algorithm specific handle
+    uint                    index;      // algorithm specific index
     
     Vptr                    verts[2];   // endpoint vertices
     ShortVec<Tptr, 2>       tris;       // incident triangles
@@ -38,6 +38,10 @@ template<class VertData, class TriData>
 Mesh<VertData,TriData>::Mesh() {}
 template<class VertData, class TriData>
 Mesh<VertData,TriData>::Mesh(Mesh &&cp)
+    : tris(std::move(cp.tris)), verts(std::move(cp.verts))
+{}
+template<class VertData, class TriData>
+Mesh<VertData,TriData>::Mesh(const Mesh &cp)
     : tris(cp.tris), verts(cp.verts)
 {}
 template<class VertData, class TriData>
@@ -57,6 +61,12 @@ Mesh<VertData,TriData>::~Mesh() {}
 
 template<class VertData, class TriData>
 void Mesh<VertData,TriData>::operator=(Mesh &&src)
+{
+    tris = std::move(src.tris);
+    verts = std::move(src.verts);
+}
+template<class VertData, class TriData>
+void Mesh<VertData,TriData>::operator=(const Mesh &src)
 {
     tris = src.tris;
     verts = src.verts;
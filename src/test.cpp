@@ -0,0 +1,577 @@
+// +-------------------------------------------------------------------------
+// | test.cpp
+// | 
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+
+// Checks of the inside/outside classification on solids which come
+// very close to each other without touching, and that the fast paths
+// (SIMD, inline limb arithmetic) agree exactly with the code they
+// stand in for.  Run with  make test
+
+#include "cork.h"
+#include "prelude.h"
+#include "vec.h"
+#include "fastWinding.h"
+#include "simdBox.h"
+#include "empty3d.h"
+#include "fixint.h"
+
+#include <map>
+#include <iostream>
+using std::cout;
+using std::endl;
+
+static int failures = 0;
+
+#define CHECK(STATEMENT) { \
+    if(!(STATEMENT)) { \
+        cout << "FAILED at line #" << __LINE__ << ": " \
+             << #STATEMENT << endl; \
+        failures++; \
+    } \
+}
+
+// the box [lo,hi], each face cut into a res x res grid of squares,
+// with the triangles facing out
+static void makeBox(CorkTriMesh *mesh, Vec3d lo, Vec3d hi, int res)
+{
+    std::vector<float>  verts;
+    std::vector<uint>   tris;
+    std::map<std::vector<int>, uint> ids; // grid point -> vertex
+    auto vert = [&](int i, int j, int k)->uint {
+        std::vector<int> key = { i, j, k };
+        auto it = ids.find(key);
+        if(it != ids.end())
+            return it->second;
+        uint id = verts.size() / 3;
+        int  ijk[3] = { i, j, k };
+        for(uint a=0; a<3; a++)
+            verts.push_back(lo[a] + (hi[a] - lo[a]) * ijk[a] / res);
+        ids[key] = id;
+        return id;
+    };
+    
+    for(int axis=0; axis<3; axis++) {
+        for(int side=0; side<2; side++) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+            for(int a=0; a<res; a++) {
+                for(int b=0; b<res; b++) {
+                    uint corner[4];
+                    for(int c=0; c<4; c++) {
+                        int ijk[3];
+                        ijk[axis] = side * res;
+                        ijk[u]    = a + (c == 1 || c == 2);
+                        ijk[v]    = b + (c == 2 || c == 3);
+                        corner[c] = vert(ijk[0], ijk[1], ijk[2]);
+                    }
+                    // (u,v,axis) is right handed, so counter-clockwise
+                    // in (u,v) faces along +axis
+                    if(side == 0)
+                        std::swap(corner[1], corner[3]);
+                    uint quad[6] = { corner[0], corner[1], corner[2],
+                                     corner[0], corner[2], corner[3] };
+                    tris.insert(tris.end(), quad, quad + 6);
+                }
+            }
+        }
+    }
+    
+    mesh->n_vertices    = verts.size() / 3;
+    mesh->n_triangles   = tris.size() / 3;
+    mesh->vertices      = new float[verts.size()];
+    mesh->triangles     = new uint[tris.size()];
+    std::copy(verts.begin(), verts.end(), mesh->vertices);
+    std::copy(tris.begin(), tris.end(), mesh->triangles);
+}
+
+static double volume(const CorkTriMesh &mesh)
+{
+    double vol = 0.0;
+    for(uint t=0; t<mesh.n_triangles; t++) {
+        Vec3d p[3];
+        for(uint k=0; k<3; k++) {
+            const float *v = mesh.vertices + 3 * mesh.triangles[3*t + k];
+            p[k] = Vec3d(v[0], v[1], v[2]);
+        }
+        vol += det(p[0], p[1], p[2]) / 6.0;
+    }
+    return vol;
+}
+
+// The fast winding numbers must be within their error bound of the
+// exact ones, however close the query comes to the surface
+static void testWindingNearSurface()
+{
+    CorkTriMesh box;
+    makeBox(&box, Vec3d(0,0,0), Vec3d(1,1,1), 16);
+    std::vector<WindingTri> tris(box.n_triangles);
+    for(uint t=0; t<box.n_triangles; t++) {
+        for(uint k=0; k<3; k++) {
+            const float *v = box.vertices + 3 * box.triangles[3*t + k];
+            tris[t].v[k] = Vec3d(v[0], v[1], v[2]);
+        }
+    }
+    FastWinding winding(tris);
+    
+    RandomStream rand(1);
+    for(uint i=0; i<200; i++) {
+        double x = rand.drand(0.0, 1.0);
+        double y = rand.drand(0.0, 1.0);
+        for(double offset = 0.1; offset > 1.0e-8; offset /= 10.0) {
+            for(int side=-1; side<=1; side+=2) {
+                Vec3d  q(x, y, 1.0 + side * offset);
+                double err;
+                double approx = winding.winding(q, &err);
+                double exact  = winding.exactWinding(q);
+                CHECK(err <= FAST_WINDING_TOLERANCE);
+                CHECK(fabs(approx - exact) <= err);
+                CHECK((approx > 0.5) == (side < 0));
+            }
+        }
+    }
+    freeCorkTriMesh(&box);
+}
+
+// Boolean operations on boxes which come within GAP of each other;
+// these only differ in how the components are classified
+static void testNearTouchingBooleans()
+{
+    // well above the nudges degenerate vertices can get
+    const double GAP = 1.0 / 4096.0;
+    CorkTriMesh outer, inside, below;
+    makeBox(&outer,  Vec3d(0,0,0),              Vec3d(1,1,1),           8);
+    makeBox(&inside, Vec3d(0.25,0.25,GAP),      Vec3d(0.75,0.75,0.5),   4);
+    makeBox(&below,  Vec3d(0.25,0.25,-0.5),     Vec3d(0.75,0.75,-GAP),  4);
+    double v_inside = volume(inside);
+    double v_below  = volume(below);
+    const double TOL = 1.0e-4;
+    
+    CorkTriMesh result;
+    computeUnion(outer, inside, &result);
+    CHECK(fabs(volume(result) - 1.0) < TOL);
+    freeCorkTriMesh(&result);
+    computeIntersection(outer, inside, &result);
+    CHECK(fabs(volume(result) - v_inside) < TOL);
+    freeCorkTriMesh(&result);
+    computeDifference(outer, inside, &result);
+    CHECK(fabs(volume(result) - (1.0 - v_inside)) < TOL);
+    freeCorkTriMesh(&result);
+    
+    computeUnion(outer, below, &result);
+    CHECK(fabs(volume(result) - (1.0 + v_below)) < TOL);
+    freeCorkTriMesh(&result);
+    computeIntersection(outer, below, &result);
+    CHECK(result.n_triangles == 0);
+    freeCorkTriMesh(&result);
+    computeDifference(below, outer, &result);
+    CHECK(fabs(volume(result) - v_below) < TOL);
+    freeCorkTriMesh(&result);
+    
+    freeCorkTriMesh(&outer);
+    freeCorkTriMesh(&inside);
+    freeCorkTriMesh(&below);
+}
+
+static bool sameMesh(const CorkTriMesh &a, const CorkTriMesh &b)
+{
+    return a.n_vertices == b.n_vertices &&
+           a.n_triangles == b.n_triangles &&
+           std::equal(a.vertices, a.vertices + 3*a.n_vertices,
+                      b.vertices) &&
+           std::equal(a.triangles, a.triangles + 3*a.n_triangles,
+                      b.triangles);
+}
+
+// Seeding a context again must reproduce its results
+static void testSeeding()
+{
+    CorkTriMesh a, b;
+    makeBox(&a, Vec3d(0,0,0),       Vec3d(1,1,1),       4);
+    makeBox(&b, Vec3d(0.3,0.3,0.3), Vec3d(1.3,1.3,1.3), 4);
+    CorkPreparedMesh *pa = prepareCorkMesh(a);
+    CorkPreparedMesh *pb = prepareCorkMesh(b);
+    CorkContext *ctx = newCorkContext();
+    
+    CorkPreparedMesh *result[3];
+    seedCorkContext(ctx, 7);
+    computeUnionPrepared(pa, pb, &result[0], ctx);
+    computeUnionPrepared(pa, pb, &result[1], ctx);
+    seedCorkContext(ctx, 7);
+    computeUnionPrepared(pa, pb, &result[2], ctx);
+    CorkTriMesh first, again;
+    extractCorkTriMesh(result[0], &first);
+    extractCorkTriMesh(result[2], &again);
+    CHECK(sameMesh(first, again));
+    
+    freeCorkTriMesh(&first);
+    freeCorkTriMesh(&again);
+    for(CorkPreparedMesh *r : result)
+        freeCorkPreparedMesh(r);
+    freeCorkContext(ctx);
+    freeCorkPreparedMesh(pa);
+    freeCorkPreparedMesh(pb);
+    freeCorkTriMesh(&a);
+    freeCorkTriMesh(&b);
+}
+
+// Without degeneracies nothing gets nudged, so the new vertices lie
+// on the faces of both boxes (up to float precision)
+static void testGenericUnmoved()
+{
+    Vec3d lo[2] = { Vec3d(0,0,0),          Vec3d(0.31,0.43,0.27) };
+    Vec3d hi[2] = { Vec3d(1,1,1),          Vec3d(1.37,1.23,1.29) };
+    CorkTriMesh a, b;
+    makeBox(&a, lo[0], hi[0], 4);
+    makeBox(&b, lo[1], hi[1], 4);
+    CorkPreparedMesh *pa = prepareCorkMesh(a);
+    CorkPreparedMesh *pb = prepareCorkMesh(b);
+    CorkContext *ctx = newCorkContext();
+    CorkPreparedMesh *pu;
+    computeUnionPrepared(pa, pb, &pu, ctx);
+    CorkTriMesh result;
+    extractCorkTriMesh(pu, &result);
+    CorkStats stats;
+    getCorkStats(ctx, &stats);
+    CHECK(stats.degeneracies == 0);
+    
+    const double TOL = 1.0e-6;
+    auto onFaces = [&](const float *v, uint box)->bool {
+        for(uint k=0; k<3; k++)
+            if(fabs(v[k] - lo[box][k]) < TOL ||
+               fabs(v[k] - hi[box][k]) < TOL)
+                return true;
+        return false;
+    };
+    auto isInput = [&](const float *v, const CorkTriMesh &mesh)->bool {
+        for(uint i=0; i<mesh.n_vertices; i++)
+            if(std::equal(v, v+3, mesh.vertices + 3*i))
+                return true;
+        return false;
+    };
+    for(uint i=0; i<result.n_vertices; i++) {
+        const float *v = result.vertices + 3*i;
+        if(isInput(v, a) || isInput(v, b))
+            continue;
+        CHECK(onFaces(v, 0) && onFaces(v, 1));
+    }
+    
+    freeCorkTriMesh(&result);
+    freeCorkPreparedMesh(pu);
+    freeCorkContext(ctx);
+    freeCorkPreparedMesh(pa);
+    freeCorkPreparedMesh(pb);
+    freeCorkTriMesh(&a);
+    freeCorkTriMesh(&b);
+}
+
+// The answer is cached on the handle; asking again must give it again
+static void testPreparedSolid()
+{
+    CorkTriMesh box;
+    makeBox(&box, Vec3d(0,0,0), Vec3d(1,1,1), 2);
+    CorkPreparedMesh *solid = prepareCorkMesh(box);
+    box.n_triangles--; // now there's a hole
+    CorkPreparedMesh *open  = prepareCorkMesh(box);
+    box.n_triangles++;
+    
+    for(uint i=0; i<2; i++) {
+        CHECK(isSolidPrepared(solid));
+        CHECK(!isSolidPrepared(open));
+    }
+    
+    freeCorkPreparedMesh(solid);
+    freeCorkPreparedMesh(open);
+    freeCorkTriMesh(&box);
+}
+
+// The SIMD box tests must give exactly hasIsct()'s answers, including
+// for boxes which only touch
+template<uint W>
+static void checkBoxMasks(RandomStream &rand)
+{
+    // (coordinates on a coarse grid, so that boxes often share faces)
+    auto coord = [&]() { return double(rand.randMod(8)) / 4.0; };
+    auto box   = [&]() {
+        Vec3d a(coord(), coord(), coord());
+        Vec3d b(coord(), coord(), coord());
+        return BBox3d(min(a, b), max(a, b));
+    };
+    for(uint trial=0; trial<2000; trial++) {
+        double minp[3][W], maxp[3][W];
+        BBox3d boxes[W];
+        for(uint k=0; k<W; k++) {
+            boxes[k] = box();
+            for(uint a=0; a<3; a++) {
+                minp[a][k] = boxes[k].minp[a];
+                maxp[a][k] = boxes[k].maxp[a];
+            }
+        }
+        BBox3d q = box();
+        uint expected = 0;
+        for(uint k=0; k<W; k++)
+            expected |= uint(hasIsct(boxes[k], q)) << k;
+        
+        CHECK(overlapMaskScalar<W>(minp, maxp, q) == expected);
+#ifdef CORK_SSE2
+        CHECK(overlapMaskSSE2<W>(minp, maxp, q) == expected);
+#endif
+#ifdef CORK_AVX2
+        if(simdBoxLevel() == SIMD_BOX_AVX2)
+            CHECK(overlapMaskAVX2<W>(minp, maxp, q) == expected);
+#endif
+    }
+}
+
+static void testBoxMasks()
+{
+    RandomStream rand(2);
+    checkBoxMasks<4>(rand);
+    checkBoxMasks<8>(rand);
+}
+
+static int scalarFilter(const Empty3d::TriEdgeIn &input)
+{
+    Empty3d::TriPlane tri_plane;
+    Empty3d::EdgeLine edge_line;
+    Empty3d::triPlane(tri_plane, input.tri);
+    Empty3d::edgeLine(edge_line, input.edge);
+    return Empty3d::emptyFilter(input, tri_plane, edge_line);
+}
+
+// The filter in SIMD lanes must decide every input the same way as
+// the scalar filter.  Random inputs almost never come close enough
+// to a threshold for rounding differently (say with fused
+// multiply-adds) to matter, so we move one coordinate of a degenerate
+// input until we find the two neighbouring values the scalar filter
+// decides differently on, and check those.
+static void testLaneFilter()
+{
+    RandomStream rand(3);
+    Empty3d::TriEdgeBatch batch;
+    while(batch.size() < 4000) {
+        // (points on a scaled grid, so often coplanar or collinear)
+        double scale = rand.drand(0.1, 1.0);
+        auto coord = [&]() {
+            return scale * (int(rand.randMod(9)) - 4);
+        };
+        Empty3d::TriEdgeIn input;
+        for(uint i=0; i<3; i++) {
+            input.tri.p[i]  = Vec3d(coord(), coord(), coord());
+            input.tri.id[i] = i;
+        }
+        for(uint i=0; i<2; i++) {
+            input.edge.p[i]  = Vec3d(coord(), coord(), coord());
+            input.edge.id[i] = 3 + i;
+        }
+        uint    which   = rand.randMod(5);
+        double  *c      = (which < 3)? &input.tri.p[which].v[0]
+                                     : &input.edge.p[which - 3].v[0];
+        c += rand.randMod(3);
+        
+        double base = *c;
+        double lo   = 0.0;
+        double hi   = 1.0;
+        *c = base + lo;     int decide_lo = scalarFilter(input);
+        *c = base + hi;     int decide_hi = scalarFilter(input);
+        if(decide_lo == decide_hi)      continue;
+        while(true) {
+            double mid = lo + (hi - lo) / 2.0;
+            if(mid == lo || mid == hi)  break;
+            *c = base + mid;
+            if(scalarFilter(input) == decide_lo)    lo = mid;
+            else                                    hi = mid;
+        }
+        for(double offset : { lo, hi }) {
+            *c = base + offset;
+            Empty3d::TriPlane tri_plane;
+            Empty3d::EdgeLine edge_line;
+            Empty3d::triPlane(tri_plane, input.tri);
+            Empty3d::edgeLine(edge_line, input.edge);
+            batch.push_back(input, tri_plane, edge_line);
+        }
+    }
+    
+    std::vector<int> scalar(batch.size());
+    for(uint n=0; n<batch.size(); n++)
+        scalar[n] = scalarFilter(batch.inputs[n]);
+    for(uint width : { 4, 8 }) {
+        std::vector<int> lanes(batch.size());
+        uint end = Empty3d::emptyFilterLanes(batch, width, lanes.data());
+        uint mismatches = 0;
+        for(uint n=0; n<end; n++)
+            if(lanes[n] != scalar[n])   mismatches++;
+        CHECK(mismatches == 0);
+    }
+}
+
+// The inline limb loops in fixint.h must give exactly what the mpn
+// routines they replace give, for every size they're used at
+static void randomLimbs(RandomStream &rand, mp_limb_t *limbs, uint n)
+{
+    // (lots of all-zero and all-one limbs, to exercise the carries)
+    for(uint i=0; i<n; i++) {
+        switch(rand.randMod(4)) {
+            case 0:     limbs[i] = 0;                   break;
+            case 1:     limbs[i] = ~mp_limb_t(0);       break;
+            default:    limbs[i] = rand.next();         break;
+        }
+    }
+}
+
+template<int A, int B>
+static void checkLimbs(RandomStream &rand)
+{
+    using namespace FixInt;
+    for(uint trial=0; trial<200; trial++) {
+        mp_limb_t lhs[A], rhs[B], out[A+B], ref[A+B];
+        randomLimbs(rand, lhs, A);
+        randomLimbs(rand, rhs, B);
+        
+        limbMul<A,B>(out, lhs, rhs);
+        if(A >= B)  mpn_mul(ref, lhs, A, rhs, B);
+        else        mpn_mul(ref, rhs, B, lhs, A);
+        CHECK(std::equal(out, out + A+B, ref));
+        
+        if(A > B) {
+            mp_limb_t carry     = limbAdd<A,B>(out, lhs, rhs);
+            mp_limb_t ref_carry = mpn_add(ref, lhs, A, rhs, B);
+            CHECK(carry == ref_carry && std::equal(out, out + A, ref));
+        }
+        if(A == B) {
+            mp_limb_t carry     = limbAddN<A>(out, lhs, rhs);
+            mp_limb_t ref_carry = mpn_add_n(ref, lhs, rhs, A);
+            CHECK(carry == ref_carry && std::equal(out, out + A, ref));
+            
+            carry       = limbSub1<A>(out, lhs, rhs[0] % 3);
+            ref_carry   = mpn_sub_1(ref, lhs, A, rhs[0] % 3);
+            CHECK(carry == ref_carry && std::equal(out, out + A, ref));
+            
+            limbNeg<A>(out, lhs);
+            mpn_neg(ref, lhs, A);
+            CHECK(std::equal(out, out + A, ref));
+            
+            std::copy(rhs, rhs + A, out);
+            std::copy(rhs, rhs + A, ref);
+            carry       = limbSubmul1<A>(out, lhs, rhs[A-1]);
+            ref_carry   = mpn_submul_1(ref, lhs, A, rhs[A-1]);
+            CHECK(carry == ref_carry && std::equal(out, out + A, ref));
+        }
+    }
+}
+
+// (every A x B from 1 x 1 up to 10 x 10)
+template<int A, int B>
+struct LimbSizes {
+    static void check(RandomStream &rand) {
+        LimbSizes<A, B-1>::check(rand);
+        checkLimbs<A,B>(rand);
+    }
+};
+template<int A>
+struct LimbSizes<A, 0> {
+    static void check(RandomStream &rand) {
+        LimbSizes<A-1, 10>::check(rand);
+    }
+};
+template<>
+struct LimbSizes<0, 10> {
+    static void check(RandomStream &) {}
+};
+
+// approximate() must round (towards zero) the same way as mpz_get_d()
+template<int N>
+static void checkApproximate(const FixInt::LimbInt<N> &x)
+{
+    using namespace FixInt;
+    mp_limb_t mag[N];
+    bool neg = SIGN_BOOL(x.limbs, N);
+    if(neg)     mpn_neg(mag, x.limbs, N);
+    else        std::copy(x.limbs, x.limbs + N, mag);
+    mpz_t z;
+    mpz_init(z);
+    mpz_import(z, N, -1, sizeof(mp_limb_t), 0, 0, mag);
+    if(neg)     mpz_neg(z, z);
+    CHECK(approximate(x) == mpz_get_d(z));
+    mpz_clear(z);
+}
+
+template<int N>
+static void checkApproximate(RandomStream &rand)
+{
+    using namespace FixInt;
+    // small values, and either side of 2^53
+    for(int k : { 0, 1, -1, 3, -7 })
+        checkApproximate(LimbInt<N>(k));
+    for(long long k : { (1LL<<53) - 1, 1LL<<53, (1LL<<53) + 1,
+                        (1LL<<54) + 3, -(1LL<<53) - 1 }) {
+        LimbInt<N> x;
+        x.limbs[0] = mp_limb_t(k);
+        for(int i=1; i<N; i++)
+            x.limbs[i] = (k < 0)? ~mp_limb_t(0) : 0;
+        checkApproximate(x);
+    }
+    // the most negative value
+    LimbInt<N> x(0);
+    x.limbs[N-1] = LIMB_SIGN_MASK;
+    checkApproximate(x);
+    // and random ones of every length
+    for(uint trial=0; trial<2000; trial++) {
+        uint len = 1 + rand.randMod(N);
+        randomLimbs(rand, x.limbs, len);
+        x.limbs[len-1] >>= rand.randMod(LIMB_BIT_SIZE);
+        bool neg = rand.randMod(2);
+        for(uint i=len; i<N; i++)
+            x.limbs[i] = (neg)? ~mp_limb_t(0) : 0;
+        checkApproximate(x);
+    }
+}
+
+static void testFixInt()
+{
+    RandomStream rand(4);
+    LimbSizes<10, 10>::check(rand);
+    checkApproximate<1>(rand);
+    checkApproximate<2>(rand);
+    checkApproximate<5>(rand);
+    checkApproximate<8>(rand);
+}
+
+int main()
+{
+    // (the building blocks first)
+    testBoxMasks();
+    testLaneFilter();
+    testFixInt();
+    testWindingNearSurface();
+    testNearTouchingBooleans();
+    testSeeding();
+    testGenericUnmoved();
+    testPreparedSolid();
+    
+    if(failures > 0) {
+        cout << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "all checks passed" << endl;
+    return 0;
+}
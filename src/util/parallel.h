@@ -0,0 +1,74 @@
+// +-------------------------------------------------------------------------
+// | parallel.h
+// | 
+// +-------------------------------------------------------------------------
+// | COPYRIGHT:
+// |    See the included COPYRIGHT file for further details.
+// |    
+// |    This file is part of the Cork library.
+// |
+// |    Cork is free software: you can redistribute it and/or modify
+// |    it under the terms of the GNU Lesser General Public License as
+// |    published by the Free Software Foundation, either version 3 of
+// |    the License, or (at your option) any later version.
+// |
+// |    Cork is distributed in the hope that it will be useful,
+// |    but WITHOUT ANY WARRANTY; without even the implied warranty of
+// |    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// |    GNU Lesser General Public License for more details.
+// |
+// |    You should have received a copy 
+// |    of the GNU Lesser General Public License
+// |    along with Cork.  If not, see <http://www.gnu.org/licenses/>.
+// +-------------------------------------------------------------------------
+#pragma once
+
+#include "prelude.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <functional>
+
+// the number of threads to use when the caller doesn't say
+inline uint defaultThreadCount()
+{
+    uint n = std::thread::hardware_concurrency();
+    return (n > 0)? n : 1;
+}
+
+// Call func(i, thread) for every i in [0, n), using up to n_threads
+// threads (including the calling one); n_threads = 0 means use
+// defaultThreadCount().  thread is in [0, n_threads) and identifies the
+// thread making the call, so that func can keep scratch space per thread.
+// Items are handed out one at a time, so uneven work per item balances
+// out; the order in which items are processed is unspecified.
+// Threads are started for each call, so a thread is only used for every
+// grain items; small ranges of cheap items just run on the calling thread.
+inline void parallelFor(uint n, uint n_threads,
+                        std::function<void(uint i, uint thread)> func,
+                        uint grain = 1)
+{
+    if(n_threads == 0)
+        n_threads = defaultThreadCount();
+    if(n_threads > n / grain)
+        n_threads = n / grain;
+    if(n_threads <= 1) {
+        for(uint i=0; i<n; i++)
+            func(i, 0);
+        return;
+    }
+    
+    std::atomic<uint> next(0);
+    auto worker = [&](uint thread) {
+        for(uint i = next++; i < n; i = next++)
+            func(i, thread);
+    };
+    
+    std::vector<std::thread> threads;
+    for(uint t=1; t<n_threads; t++)
+        threads.push_back(std::thread(worker, t));
+    worker(0);
+    for(std::thread &th : threads)
+        th.join();
+}
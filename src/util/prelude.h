@@ -160,5 +160,35 @@ inline uint randMod(uint range) {
     return std::rand()%range;
 }
 
+// An independent, seedable random source (xorshift64*).
+// Unlike the functions above, it has no hidden shared state,
+// so separate streams may be used safely from separate threads
+// and replayed by re-using the seed.
+class RandomStream {
+public:
+    RandomStream(unsigned long long seed = 0x9E3779B97F4A7C15ULL) {
+        reseed(seed);
+    }
+    inline void reseed(unsigned long long seed) {
+        state = (seed)? seed : 1; // state must never be zero
+    }
+    inline unsigned long long next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+    inline double drand(double min, double max) {
+        // use the top 53 bits to fill out a double in [0,1)
+        double rand0to1 = double(next() >> 11) * (1.0/9007199254740992.0);
+        return (max-min)*rand0to1 + min;
+    }
+    inline uint randMod(uint range) {
+        return uint(next() % range);
+    }
+private:
+    unsigned long long state;
+};
+
 
 
@@ -26,7 +26,6 @@
 #pragma once
 
 #include "prelude.h"
-#include "memPool.h"
 
 #include <algorithm>
 
@@ -34,11 +33,14 @@
 // when I make the datablock def. a member of ShortVec<T,LEN>
 template<class T, uint LEN>
 struct ShortVecBlock_Private {
-    byte data[sizeof(T)*LEN];
+    alignas(T) byte data[sizeof(T)*LEN];
 };
-// We allocate these blocks instead of typed arrays
-// in order to ensure that we get control of allocation/deallocation
-// rather than the allocator attempting to do so.
+// We use these blocks instead of typed arrays
+// in order to ensure that we get control of construction/destruction
+// rather than the compiler attempting to do so.
+// The first LEN entries are stored in a block inside the ShortVec
+// itself, so there is no allocator state shared between ShortVecs;
+// they may be used freely from multiple threads.
 
 template<class T, uint LEN>
 class ShortVec
@@ -75,6 +77,7 @@ public: // modifiers
 private: // helper functions
     T*   allocData(uint space, uint &allocated);
     void deallocData(T* data_ptr, uint allocated);
+    inline T* localData() { return reinterpret_cast<T*>(local.data); }
     
     void constructRange(T* array, int begin, int end);
     void copyConstructRange(T* src, T* dest, int begin, int end);
@@ -84,26 +87,21 @@ private: // helper functions
     // but not construction/destruction
     void resizeHelper(uint newsize);
     
-public: // shared data structures and data.
-    static MemPool< ShortVecBlock_Private<T,LEN> > pool;
-    
 private: // instance data
     uint user_size;     // actual number of entries from client perspective
-    uint internal_size; // number of entries allocated, if greater than LEN;
-                        // if allocated from the memory pool, this is 0
+    uint internal_size; // number of entries allocated;
+                        // if using the local block, this is LEN
     T* data;
+    ShortVecBlock_Private<T,LEN> local;
 };
 
-template<class T, uint LEN>
-MemPool< ShortVecBlock_Private<T,LEN> > ShortVec<T,LEN>::pool;
-
 template<class T, uint LEN> inline
 T* ShortVec<T,LEN>::allocData(uint space, uint &allocated)
 {
     T* result;
     if(space <= LEN) {
         allocated = LEN;
-        result =  reinterpret_cast<T*>(pool.alloc());
+        result =  localData();
     } else {
         allocated = space;
         result = reinterpret_cast<T*>(new byte[sizeof(T)*space]);
@@ -115,9 +113,7 @@ template<class T, uint LEN> inline
 void ShortVec<T,LEN>::deallocData(T* data_ptr, uint allocated)
 {
     //if(LEN == 2) std::cout << "        Deallocing: " << data_ptr << std::endl;
-    if(allocated <= LEN)
-        pool.free(reinterpret_cast< ShortVecBlock_Private<T,LEN>* >(data_ptr));
-    else
+    if(allocated > LEN)
         delete[] reinterpret_cast<byte*>(data_ptr);
 }
 